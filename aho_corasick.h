@@ -0,0 +1,371 @@
+// aho_corasick.h - Scans text for every key of a trie in one pass
+// Copyright (C) 2013  George Hilliard
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef AHO_CORASICK_H
+#define AHO_CORASICK_H
+
+#include <vector>
+#include <iterator>
+#include <algorithm>
+#include <cstdint>
+#include <cstddef>
+#include <limits>
+#include <utility>
+#include <stdexcept>
+#include <type_traits>
+
+#include "trie.h"
+
+// An Aho-Corasick automaton for the keys of a trie of byte-symbol keys, made
+// by trie<T>::matcher().  It finds every occurrence of every key in a text,
+// overlapping ones included, reading each symbol once.
+//
+// A state is the longest key prefix that the text read so far ends with.  The
+// failure links are folded into a full transition table, so each symbol costs
+// one table lookup no matter how many keys there are, and output links chain
+// each state to the shorter keys that end where it does.  Symbols are first
+// mapped to classes, all the ones no key uses sharing class 0, so a row of
+// the table is only as wide as the keys' alphabet.  That row per state is the
+// price of the speed: this suits keyword lists rather than millions of keys.
+//
+// The empty key is never reported.
+template<typename T>
+class aho_corasick {
+	// data members and types
+	typedef typename T::value_type symbol;
+	static_assert(trie_byte_symbol<symbol>::value, "aho_corasick needs byte-sized symbols");
+
+	// For each state some key ends in
+	struct output {
+		uint32_t length;  // of the state's own key, or 0 if it has none
+		uint32_t next;    // the output of the next shorter key ending here, or none
+	};
+	static constexpr uint32_t none = std::numeric_limits<uint32_t>::max();
+
+	uint32_t classes[256];
+	uint32_t width = 1;
+	// Row s * width holds the transitions of state s, and each entry is
+	// the next state's row rather than its number.  States are numbered
+	// breadth first, except that those where a key ends come last, from
+	// row first_output on, so spotting a match takes one comparison.
+	std::vector<uint32_t> table;
+	uint32_t first_output = 1;
+	std::vector<output> outputs;
+	uint32_t longest = 0;
+	size_t keys = 0;
+
+public:
+	// misc. declarations
+	class stream;
+	typedef T key_type;
+	typedef T value_type;
+	typedef size_t size_type;
+
+	// constructors
+	aho_corasick();
+	template<typename Alloc, typename Mapped> explicit aho_corasick(const trie<T, Alloc, Mapped>&);
+
+	// other members
+	bool empty() const { return keys == 0; }
+	size_type size() const { return keys; }
+	size_type states() const { return table.size() / width; }
+	// Bytes taken by the tables
+	size_type memory_usage() const {
+		return sizeof(*this) + table.capacity() * sizeof(uint32_t) + outputs.capacity() * sizeof(output);
+	}
+
+	// A scan over text that arrives in pieces; see stream.
+	stream start() const { return stream{*this}; }
+	// Calls f(end, length) for every key found in the text, where the key is
+	// the length symbols before offset end.  The text can be key-like (see
+	// trie_key_like), a pointer and a length, or an iterator pair.
+	template<typename K, typename F, typename = typename std::enable_if<trie_key_like<K, symbol>::value>::type>
+	void scan(const K& text, F f) const { start().scan(text.cbegin(), text.cend(), f); }
+	template<typename F> void scan(const symbol* text, size_type length, F f) const { start().scan(text, text + length, f); }
+	template<typename InputIt, typename F> void scan(InputIt first, InputIt last, F f) const { start().scan(first, last, f); }
+
+	void swap(aho_corasick& other) {
+		std::swap(classes, other.classes);
+		std::swap(width, other.width);
+		table.swap(other.table);
+		std::swap(first_output, other.first_output);
+		outputs.swap(other.outputs);
+		std::swap(longest, other.longest);
+		std::swap(keys, other.keys);
+	}
+	static void swap(aho_corasick& a, aho_corasick& b) { a.swap(b); }
+
+private:
+	static unsigned char byte(const symbol& s) { return static_cast<unsigned char>(s); }
+	// Calls f for every key ending in the state at row.
+	template<typename F> void report(uint32_t row, size_type end, F& f) const {
+		for(uint32_t o = row / width - first_output / width; o != none; o = outputs[o].next)
+			if(outputs[o].length != 0)
+				f(end, size_type{outputs[o].length});
+	}
+};
+
+// Where a scan is up to: the automaton's state and how much text it has
+// read.  Feed it the text one piece after another, e.g. straight from
+// read() buffers; keys that straddle two pieces are found, and offsets count
+// from the start of the first piece.  The automaton must outlive it.
+//
+// Each symbol's lookup needs the state the last one led to, so a scan waits
+// on one load after another.  A long piece of random access text is
+// therefore cut into a few segments that are scanned side by side, their
+// loads overlapping.  Each segment but the first starts longest - 1 symbols
+// early, which is enough to bring it to the right state, and its matches
+// are held back until those of the segments before it are reported, so
+// matches still come in order of where they end.
+template<typename T>
+class aho_corasick<T>::stream {
+	static constexpr size_type lanes = 4;
+	// Shorter pieces aren't worth cutting up.
+	static constexpr size_type shortest_segment = 4096;
+
+	const aho_corasick* automaton;
+	uint32_t row = 0;
+	size_type read = 0;
+	// Matches (end, state row) found by segments 1 and on
+	std::vector<std::pair<size_type, uint32_t>> held[lanes - 1];
+
+	template<typename InputIt, typename F> void scan(InputIt, InputIt, F&, std::input_iterator_tag);
+	template<typename RandomIt, typename F> void scan(RandomIt, RandomIt, F&, std::random_access_iterator_tag);
+
+public:
+	explicit stream(const aho_corasick& automaton) : automaton{&automaton} {}
+
+	template<typename K, typename F, typename = typename std::enable_if<trie_key_like<K, symbol>::value>::type>
+	void scan(const K& text, F f) { scan(text.cbegin(), text.cend(), f); }
+	template<typename F> void scan(const symbol* text, size_type length, F f) { scan(text, text + length, f); }
+	template<typename InputIt, typename F> void scan(InputIt first, InputIt last, F f) {
+		scan(first, last, f, typename std::iterator_traits<InputIt>::iterator_category{});
+	}
+
+	// Symbols read so far
+	size_type position() const { return read; }
+	// Starts over, as if nothing had been read.
+	void reset() {
+		row = 0;
+		read = 0;
+	}
+};
+
+template<typename T>
+constexpr uint32_t aho_corasick<T>::none;
+template<typename T>
+constexpr typename aho_corasick<T>::size_type aho_corasick<T>::stream::lanes;
+template<typename T>
+constexpr typename aho_corasick<T>::size_type aho_corasick<T>::stream::shortest_segment;
+
+template<typename T, typename Alloc, typename Mapped>
+aho_corasick<T> trie<T, Alloc, Mapped>::matcher() const
+{
+	return aho_corasick<T>(*this);
+}
+
+template<typename T>
+aho_corasick<T>::aho_corasick() :
+	table(1, 0)
+{
+	for(auto& c: classes)
+		c = 0;
+}
+
+template<typename T>
+template<typename Alloc, typename Mapped>
+aho_corasick<T>::aho_corasick(const trie<T, Alloc, Mapped>& from) :
+	aho_corasick()
+{
+	typedef typename trie<T, Alloc, Mapped>::node node;
+	struct state {
+		const node* n;     // nullptr for a nullptr child, which ends a key
+		uint32_t parent;
+		uint32_t depth;
+		unsigned char s;   // the symbol from the parent
+		bool is_key;
+	};
+
+	// The trie's nodes breadth first, and the symbols they use
+	std::vector<state> order{state{&from.root, 0, 0, 0, false}};
+	bool used[256] = {};
+	for(size_t i = 0; i < order.size(); ++i) {
+		const node* n = order[i].n;
+		if(n == nullptr)
+			continue;
+		for(auto slot = n->children.first(); slot != n->children.end_slot(); slot = n->children.next(slot)) {
+			const node* child = n->children.child(slot);
+			unsigned char s = byte(n->children.symbol(slot));
+			used[s] = true;
+			order.push_back(state{child, uint32_t(i), order[i].depth + 1, s, child == nullptr || child->is_leaf});
+		}
+	}
+	for(unsigned s = 0; s < 256; ++s)
+		if(used[s])
+			classes[s] = width++;
+	if(order.size() > none / width)
+		throw std::length_error("aho_corasick: too many states");
+	uint32_t count = order.size();
+
+	// The trie's own edges, by state number...
+	std::vector<uint32_t> next(size_t(count) * width, none);
+	for(uint32_t i = 1; i < count; ++i)
+		next[size_t(order[i].parent) * width + classes[order[i].s]] = i;
+	// ...then, breadth first, each missing edge becomes the one the failure
+	// state takes.  That state is shallower, so its row is already whole.
+	std::vector<uint32_t> fail(count, 0);
+	for(uint32_t i = 0; i < count; ++i) {
+		uint32_t* row = &next[size_t(i) * width];
+		const uint32_t* fallback = &next[size_t(fail[i]) * width];
+		for(uint32_t c = 0; c < width; ++c) {
+			uint32_t to = i == 0 ? 0 : fallback[c];
+			if(row[c] == none)
+				row[c] = to;
+			else
+				fail[row[c]] = to;
+		}
+	}
+
+	// A state outputs its own key and whatever its failure state outputs.
+	std::vector<uint32_t> shorter(count, none);  // the next state down with a key of its own
+	std::vector<bool> has_output(count, false);
+	for(uint32_t i = 1; i < count; ++i) {
+		uint32_t f = fail[i];
+		shorter[i] = order[f].is_key ? f : shorter[f];
+		has_output[i] = order[i].is_key || shorter[i] != none;
+	}
+
+	// Renumber with the output states last, and store rows instead of numbers.
+	std::vector<uint32_t> number(count);
+	uint32_t n = 0;
+	for(uint32_t i = 0; i < count; ++i)
+		if(!has_output[i])
+			number[i] = n++;
+	uint32_t first = n;
+	for(uint32_t i = 0; i < count; ++i)
+		if(has_output[i])
+			number[i] = n++;
+
+	table.assign(size_t(count) * width, 0);
+	for(uint32_t i = 0; i < count; ++i)
+		for(uint32_t c = 0; c < width; ++c)
+			table[size_t(number[i]) * width + c] = number[next[size_t(i) * width + c]] * width;
+	first_output = first * width;
+	outputs.resize(count - first);
+	for(uint32_t i = 0; i < count; ++i)
+		if(has_output[i]) {
+			uint32_t s = shorter[i];
+			outputs[number[i] - first] = output{order[i].is_key ? order[i].depth : 0, s == none ? none : number[s] - first};
+		}
+
+	for(const auto& s: order)
+		if(s.is_key)
+			longest = std::max(longest, s.depth);
+	keys = from.size() - (from.root.is_leaf ? 1 : 0);
+}
+
+template<typename T>
+template<typename InputIt, typename F>
+void aho_corasick<T>::stream::scan(InputIt first, InputIt last, F& f, std::input_iterator_tag)
+{
+	// Kept in locals so the loop needn't reload them after calling f.
+	const uint32_t* table = automaton->table.data();
+	const uint32_t* classes = automaton->classes;
+	const uint32_t first_output = automaton->first_output;
+	uint32_t at = row;
+	size_type end = read;
+
+	for(; first != last; ++first) {
+		at = table[at + classes[byte(*first)]];
+		++end;
+		if(at >= first_output)
+			automaton->report(at, end, f);
+	}
+	row = at;
+	read = end;
+}
+
+template<typename T>
+template<typename RandomIt, typename F>
+void aho_corasick<T>::stream::scan(RandomIt first, RandomIt last, F& f, std::random_access_iterator_tag)
+{
+	size_type length = last - first;
+	size_type warmup = automaton->longest == 0 ? 0 : automaton->longest - 1;
+	size_type segment = length / lanes;
+	if(segment < shortest_segment || segment < 4 * warmup) {
+		scan(first, last, f, std::input_iterator_tag{});
+		return;
+	}
+
+	const uint32_t* table = automaton->table.data();
+	const uint32_t* classes = automaton->classes;
+	const uint32_t first_output = automaton->first_output;
+
+	// Segment k is [k * segment, (k + 1) * segment), the last one running
+	// to the end, but it is read from warmup symbols before that.  The four
+	// are spelled out so that their states stay in registers.
+	static_assert(lanes == 4, "the scan loop reads four segments");
+	RandomIt at[lanes];
+	for(size_type k = 0; k < lanes; ++k)
+		at[k] = first + (k == 0 ? 0 : k * segment - warmup);
+	uint32_t s0 = row, s1 = 0, s2 = 0, s3 = 0;
+	for(auto& matches: held)
+		matches.clear();
+	auto hold = [&](size_type k, RandomIt p, uint32_t s) {
+		// Matches ending in the part read to warm up belong to the segment before.
+		size_type end = p + 1 - first;
+		if(end > k * segment)
+			held[k - 1].emplace_back(read + end, s);
+	};
+
+	// Side by side for as far as the first segment goes...
+	for(size_type i = 0; i < segment; ++i) {
+		s0 = table[s0 + classes[byte(at[0][i])]];
+		s1 = table[s1 + classes[byte(at[1][i])]];
+		s2 = table[s2 + classes[byte(at[2][i])]];
+		s3 = table[s3 + classes[byte(at[3][i])]];
+		if(std::max(std::max(s0, s1), std::max(s2, s3)) >= first_output) {
+			if(s0 >= first_output)
+				automaton->report(s0, read + i + 1, f);
+			if(s1 >= first_output)
+				hold(1, at[1] + i, s1);
+			if(s2 >= first_output)
+				hold(2, at[2] + i, s2);
+			if(s3 >= first_output)
+				hold(3, at[3] + i, s3);
+		}
+	}
+	// ...then each of the others on its own to its end.
+	uint32_t state[lanes] = {s0, s1, s2, s3};
+	for(size_type k = 1; k < lanes; ++k) {
+		RandomIt stop = k + 1 == lanes ? last : first + (k + 1) * segment;
+		uint32_t s = state[k];
+		for(RandomIt p = at[k] + segment; p != stop; ++p) {
+			s = table[s + classes[byte(*p)]];
+			if(s >= first_output)
+				hold(k, p, s);
+		}
+		state[k] = s;
+	}
+
+	for(auto& matches: held)
+		for(const auto& m: matches)
+			automaton->report(m.second, m.first, f);
+	row = state[lanes - 1];
+	read += length;
+}
+
+#endif
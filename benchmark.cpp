@@ -4,17 +4,51 @@
 #include <string>
 #include <list>
 #include <set>
+#include <map>
 #include <unordered_set>
+#include <unordered_map>
 #include <vector>
 #include <chrono>
+#include <thread>
+#include <mutex>
+#include <atomic>
 #include <algorithm>
 #include <cassert>
+#include <cstdlib>
+#include <cstdio>
+#include <new>
 
 #include "trie.h"
+#include "radix_trie.h"
+#include "trie_map.h"
+#include "trie_view.h"
+#include "double_array_trie.h"
+#include "louds_trie.h"
+#include "dawg.h"
+#include "concurrent_trie.h"
+#include "persistent_trie.h"
+#include "aho_corasick.h"
 
 using namespace std;
 using namespace std::chrono;
 
+// Every allocation goes through here, so we can count how many each container makes.
+// Both halves are kept out of line so GCC doesn't mistake malloc/free for a mismatch.
+static size_t allocationCount = 0;
+
+__attribute__((noinline)) void* operator new(size_t size)
+{
+	++allocationCount;
+	if(void* p = malloc(size))
+		return p;
+	throw bad_alloc();
+}
+
+__attribute__((noinline)) void operator delete(void* p) noexcept
+{
+	free(p);
+}
+
 template<typename T>
 void readIntoContainer(T& t)
 {
@@ -37,19 +71,109 @@ Duration timeFunctionCall(UnaryPredicate f)
 	return chrono::duration_cast<Duration>(t2 - t1);
 }
 
+// Lookup results are added here so the compiler can't throw the lookups away.
+static volatile size_t lookupSink = 0;
+
+/** An output iterator that hands everything written through it to f */
+template<typename F>
+struct callingIterator : iterator<output_iterator_tag, void, void, void, void> {
+	F f;
+	explicit callingIterator(F f) : f(f) {}
+	callingIterator& operator*() { return *this; }
+	callingIterator& operator++() { return *this; }
+	callingIterator& operator++(int) { return *this; }
+	template<typename T> callingIterator& operator=(const T& result) { f(result); return *this; }
+};
+
+template<typename F>
+callingIterator<F> callEach(F f)
+{
+	return callingIterator<F>(f);
+}
+
+/** Adds every string one edit (deletion, transposition, substitution or insertion) from word to out */
+void addEditsOf(const string& word, const string& alphabet, unordered_set<string>& out)
+{
+	for(size_t i = 0; i < word.size(); ++i)
+		out.insert(string(word).erase(i, 1));
+	for(size_t i = 0; i + 1 < word.size(); ++i) {
+		string s(word);
+		swap(s[i], s[i + 1]);
+		out.insert(s);
+	}
+	for(size_t i = 0; i < word.size(); ++i)
+		for(char c: alphabet) {
+			string s(word);
+			s[i] = c;
+			out.insert(s);
+		}
+	for(size_t i = 0; i <= word.size(); ++i)
+		for(char c: alphabet)
+			out.insert(string(word).insert(i, 1, c));
+}
+
+/** The usual spell-checker approach: look up every string within distance edits of word */
+template<typename Set>
+size_t countCandidates(const Set& set, const string& word, const string& alphabet, int distance)
+{
+	unordered_set<string> candidates{word};
+	for(int d = 0; d < distance; ++d) {
+		unordered_set<string> next;
+		for(const auto& c: candidates)
+			addEditsOf(c, alphabet, next);
+		candidates.insert(next.begin(), next.end());
+	}
+	size_t found = 0;
+	for(const auto& c: candidates)
+		found += set.count(c);
+	return found;
+}
+
+/** Returns the number of allocations made by f() */
+template<typename UnaryPredicate>
+size_t countAllocations(UnaryPredicate f)
+{
+	auto before = allocationCount;
+	f();
+	return allocationCount - before;
+}
+
+/** Returns the time taken to run f(0) ... f(threads - 1), each on its own thread */
+template<typename F>
+milliseconds timeOnThreads(unsigned threads, F f)
+{
+	return timeFunctionCall( [&]{
+		vector<thread> pool;
+		for(unsigned n = 0; n < threads; ++n)
+			pool.emplace_back(f, n);
+		for(auto& t: pool)
+			t.join();
+	} );
+}
+
 template<typename T>
 inline void outputFormat(const T& thing, ostream& stream = cout)
 {
 	stream << left << setw(20) << thing << flush;
 }
-void outputFormatHeader(string header)
+void outputFormatHeader(string header,
+                        initializer_list<const char*> columns = {"iterations", "std::list", "std::set", "std::unordered_set", "std::vector", "gh403::trie", "gh403::radix_trie"})
 {
 	cout << header << '\n';
-	for(const auto& i: {"iterations", "std::list", "std::set", "std::unordered_set", "std::vector", "gh403::trie"})
+	for(const auto& i: columns)
 		outputFormat(i);
 	cout << endl;
 }
 
+/** Outputs the time to build a trie<string, Alloc> from source, then to destroy it */
+template<typename Alloc>
+void outputBuildAndTeardown(const vector<string>& source)
+{
+	trie<string, Alloc> *t = nullptr;
+	outputFormat(timeFunctionCall( [&]{ t = new trie<string, Alloc>(source.begin(), source.end()); } ).count() );
+	outputFormat(timeFunctionCall( [&]{ delete t; } ).count() );
+}
+
 int main()
 {
 	const int largest = 1000000;
@@ -63,6 +187,7 @@ int main()
 	unordered_set<string> usrc(begin(source), begin(source) + largest);
 	vector<string>        vsrc(begin(source), begin(source) + largest);
 	trie<string>          tsrc(begin(source), begin(source) + largest);
+	radix_trie<string>    rsrc(begin(source), begin(source) + largest);
 
 	outputFormatHeader("INSERTION");
 	for(int i = 0; i <= largest; i += 20000) {
@@ -71,6 +196,7 @@ int main()
 		unordered_set<string> *u = new unordered_set<string>;
 		vector<string>        *v = new vector<string>;
 		trie<string>          *t = new trie<string>;
+		radix_trie<string>    *r = new radix_trie<string>;
 
 		vector<string> source_cpy(source.cbegin(), source.cbegin() + i);
 		random_shuffle(begin(source_cpy), end(source_cpy));
@@ -81,6 +207,7 @@ int main()
 		outputFormat(timeFunctionCall( [&]{ u->insert(source_cpy.begin(), source_cpy.end()); } ).count() );
 		outputFormat(timeFunctionCall( [&]{ v->insert(v->begin(), source_cpy.begin(), source_cpy.end()); } ).count() );
 		outputFormat(timeFunctionCall( [&]{ t->insert(source_cpy.begin(), source_cpy.end()); } ).count() );
+		outputFormat(timeFunctionCall( [&]{ r->insert(source_cpy.begin(), source_cpy.end()); } ).count() );
 		cout << endl;
 
 		delete l;
@@ -88,6 +215,189 @@ int main()
 		delete u;
 		delete v;
 		delete t;
+		delete r;
+	}
+	cout << endl;
+
+	outputFormatHeader("BULK LOAD (SORTED INPUT)", {"iterations", "range constructor", "build_from_sorted"});
+	for(int i = 0; i <= largest; i += 100000) {
+		// Sorted the way the trie orders its symbols
+		vector<string> source_cpy(source.cbegin(), source.cbegin() + i);
+		sort(begin(source_cpy), end(source_cpy), [](const string& a, const string& b) {
+			return lexicographical_compare(a.begin(), a.end(), b.begin(), b.end());
+		});
+		trie<string> *r = nullptr;
+		trie<string> *t = new trie<string>;
+
+		outputFormat(i);
+		outputFormat(timeFunctionCall( [&]{ r = new trie<string>(source_cpy.begin(), source_cpy.end()); } ).count() );
+		outputFormat(timeFunctionCall( [&]{ t->build_from_sorted(source_cpy.begin(), source_cpy.end()); } ).count() );
+		cout << endl;
+
+		delete r;
+		delete t;
+	}
+	cout << endl;
+
+	outputFormatHeader("ALLOCATIONS (INSERTION)");
+	for(int i = 0; i <= largest; i += 100000) {
+		vector<string> source_cpy(source.cbegin(), source.cbegin() + i);
+		random_shuffle(begin(source_cpy), end(source_cpy));
+
+		outputFormat(i);
+		outputFormat(countAllocations( [&]{ list<string>          l(source_cpy.begin(), source_cpy.end()); } ));
+		outputFormat(countAllocations( [&]{ set<string>           s(source_cpy.begin(), source_cpy.end()); } ));
+		outputFormat(countAllocations( [&]{ unordered_set<string> u(source_cpy.begin(), source_cpy.end()); } ));
+		outputFormat(countAllocations( [&]{ vector<string>        v(source_cpy.begin(), source_cpy.end()); } ));
+		outputFormat(countAllocations( [&]{ trie<string>          t(source_cpy.begin(), source_cpy.end()); } ));
+		outputFormat(countAllocations( [&]{ radix_trie<string>    r(source_cpy.begin(), source_cpy.end()); } ));
+		cout << endl;
+	}
+	cout << endl;
+
+	outputFormatHeader("ALLOCATORS (BUILD / TEARDOWN)",
+	                   {"iterations", "heap build", "heap teardown", "arena build", "arena teardown", "pool build", "pool teardown"});
+	for(int i = 0; i <= largest; i += 100000) {
+		vector<string> source_cpy(source.cbegin(), source.cbegin() + i);
+		random_shuffle(begin(source_cpy), end(source_cpy));
+
+		outputFormat(i);
+		outputBuildAndTeardown<trie_heap_allocator>(source_cpy);
+		outputBuildAndTeardown<trie_arena_allocator>(source_cpy);
+		outputBuildAndTeardown<trie_pool_allocator>(source_cpy);
+		cout << endl;
+	}
+	cout << endl;
+
+	outputFormatHeader("BUILD (PARALLEL)", {"iterations", "1 thread", "2 threads", "4 threads", "8 threads", "all cores"});
+	for(int i = 0; i <= largest; i += 100000) {
+		vector<string> source_cpy(source.cbegin(), source.cbegin() + i);
+		random_shuffle(begin(source_cpy), end(source_cpy));
+
+		outputFormat(i);
+		for(unsigned threads: {1u, 2u, 4u, 8u, thread::hardware_concurrency()}) {
+			trie<string> *t = new trie<string>;
+			outputFormat(timeFunctionCall( [&]{ t->insert_parallel(source_cpy.cbegin(), source_cpy.cend(), threads); } ).count() );
+			delete t;
+		}
+		cout << endl;
+	}
+	cout << endl;
+
+	outputFormatHeader("COPY (SNAPSHOT OF ALL KEYS)", {"copies", "gh403::trie", "persistent_trie", "copy + insert"});
+	{
+		persistent_trie<string> psrc(begin(source), begin(source) + largest);
+		for(int i = 0; i <= 10; i += 2) {
+			outputFormat(i);
+			outputFormat(timeFunctionCall( [&]{ for(int n = 0; n < i; ++n) { trie<string> copy(tsrc); lookupSink += copy.size(); } } ).count() );
+			outputFormat(timeFunctionCall( [&]{ for(int n = 0; n < i; ++n) { persistent_trie<string> copy(psrc); lookupSink += copy.size(); } } ).count() );
+			// A new version of the set: only the changed path is copied
+			outputFormat(timeFunctionCall( [&]{ for(int n = 0; n < i; ++n) { persistent_trie<string> copy(psrc); copy.insert("a new key"); lookupSink += copy.size(); } } ).count() );
+			cout << endl;
+		}
+	}
+	cout << endl;
+
+	outputFormatHeader("MAP (BUILD / LOOKUP)",
+	                   {"iterations", "std::map build", "unordered build", "trie_map build", "std::map at", "unordered at", "trie_map at"});
+	for(int i = 0; i <= largest; i += 100000) {
+		map<string, size_t>           *m = new map<string, size_t>;
+		unordered_map<string, size_t> *u = new unordered_map<string, size_t>;
+		trie_map<string, size_t>      *t = new trie_map<string, size_t>;
+
+		vector<string> source_cpy(source.cbegin(), source.cbegin() + i);
+		random_shuffle(begin(source_cpy), end(source_cpy));
+
+		outputFormat(i);
+		outputFormat(timeFunctionCall( [&]{ for(size_t n = 0; n < source_cpy.size(); ++n) (*m)[source_cpy[n]] = n; } ).count() );
+		outputFormat(timeFunctionCall( [&]{ for(size_t n = 0; n < source_cpy.size(); ++n) (*u)[source_cpy[n]] = n; } ).count() );
+		outputFormat(timeFunctionCall( [&]{ for(size_t n = 0; n < source_cpy.size(); ++n) (*t)[source_cpy[n]] = n; } ).count() );
+		random_shuffle(begin(source_cpy), end(source_cpy));
+		outputFormat(timeFunctionCall( [&]{ for(auto n = source_cpy.cbegin(); n < source_cpy.cend(); ++n) lookupSink += m->at(*n); } ).count() );
+		outputFormat(timeFunctionCall( [&]{ for(auto n = source_cpy.cbegin(); n < source_cpy.cend(); ++n) lookupSink += u->at(*n); } ).count() );
+		outputFormat(timeFunctionCall( [&]{ for(auto n = source_cpy.cbegin(); n < source_cpy.cend(); ++n) lookupSink += t->at(*n); } ).count() );
+		cout << endl;
+
+		delete m;
+		delete u;
+		delete t;
+	}
+	cout << endl;
+
+	outputFormatHeader("IMAGE (WRITE / OPEN / FIND)",
+	                   {"iterations", "write image", "open trie_view", "trie count", "trie_view count"});
+	for(int i = 0; i <= largest; i += 100000) {
+		trie<string> t(source.cbegin(), source.cbegin() + i);
+		vector<string> source_cpy(source.cbegin(), source.cbegin() + i);
+		random_shuffle(begin(source_cpy), end(source_cpy));
+
+		outputFormat(i);
+		outputFormat(timeFunctionCall( [&]{ ofstream out("benchmark.trie", ios::binary); t.write_image(out); } ).count() );
+		trie_view<string> *v = nullptr;
+		outputFormat(timeFunctionCall( [&]{ v = new trie_view<string>("benchmark.trie"); } ).count() );
+		outputFormat(timeFunctionCall( [&]{ for(auto n = source_cpy.cbegin(); n < source_cpy.cend(); ++n) lookupSink += t.count(*n); } ).count() );
+		outputFormat(timeFunctionCall( [&]{ for(auto n = source_cpy.cbegin(); n < source_cpy.cend(); ++n) lookupSink += v->count(*n); } ).count() );
+		cout << endl;
+
+		delete v;
+	}
+	remove("benchmark.trie");
+	cout << endl;
+
+	outputFormatHeader("FROZEN (DOUBLE ARRAY)",
+	                   {"iterations", "freeze", "trie count", "double_array count", "trie bytes/key", "double_array b/key"});
+	for(int i = 100000; i <= largest; i += 100000) {
+		trie<string> t(source.cbegin(), source.cbegin() + i);
+		vector<string> source_cpy(source.cbegin(), source.cbegin() + i);
+		random_shuffle(begin(source_cpy), end(source_cpy));
+
+		outputFormat(i);
+		double_array_trie<string> d;
+		outputFormat(timeFunctionCall( [&]{ d = t.freeze(); } ).count() );
+		outputFormat(timeFunctionCall( [&]{ for(auto n = source_cpy.cbegin(); n < source_cpy.cend(); ++n) lookupSink += t.count(*n); } ).count() );
+		outputFormat(timeFunctionCall( [&]{ for(auto n = source_cpy.cbegin(); n < source_cpy.cend(); ++n) lookupSink += d.count(*n); } ).count() );
+		outputFormat(t.memory_usage() / t.size());
+		outputFormat(d.memory_usage() / d.size());
+		cout << endl;
+	}
+	cout << endl;
+
+	outputFormatHeader("SUCCINCT (LOUDS)",
+	                   {"iterations", "build", "trie count", "louds count", "trie bytes/key", "louds bytes/key"});
+	for(int i = 100000; i <= largest; i += 100000) {
+		trie<string> t(source.cbegin(), source.cbegin() + i);
+		vector<string> source_cpy(source.cbegin(), source.cbegin() + i);
+		random_shuffle(begin(source_cpy), end(source_cpy));
+
+		outputFormat(i);
+		louds_trie<string> *l = nullptr;
+		outputFormat(timeFunctionCall( [&]{ l = new louds_trie<string>(t); } ).count() );
+		outputFormat(timeFunctionCall( [&]{ for(auto n = source_cpy.cbegin(); n < source_cpy.cend(); ++n) lookupSink += t.count(*n); } ).count() );
+		outputFormat(timeFunctionCall( [&]{ for(auto n = source_cpy.cbegin(); n < source_cpy.cend(); ++n) lookupSink += l->count(*n); } ).count() );
+		outputFormat(t.memory_usage() / t.size());
+		outputFormat(l->memory_usage() / l->size());
+		cout << endl;
+
+		delete l;
+	}
+	cout << endl;
+
+	outputFormatHeader("MINIMIZE (DAWG)",
+	                   {"iterations", "minimize", "trie nodes", "dawg states", "trie count", "dawg count"});
+	for(int i = 100000; i <= largest; i += 100000) {
+		trie<string> t(source.cbegin(), source.cbegin() + i);
+		vector<string> source_cpy(source.cbegin(), source.cbegin() + i);
+		random_shuffle(begin(source_cpy), end(source_cpy));
+
+		outputFormat(i);
+		dawg<string> d;
+		outputFormat(timeFunctionCall( [&]{ d = t.minimize(); } ).count() );
+		// Every state merged away is a node of the trie.
+		outputFormat(d.state_count() + d.merged_count());
+		outputFormat(d.state_count());
+		outputFormat(timeFunctionCall( [&]{ for(auto n = source_cpy.cbegin(); n < source_cpy.cend(); ++n) lookupSink += t.count(*n); } ).count() );
+		outputFormat(timeFunctionCall( [&]{ for(auto n = source_cpy.cbegin(); n < source_cpy.cend(); ++n) lookupSink += d.count(*n); } ).count() );
+		cout << endl;
 	}
 	cout << endl;
 
@@ -98,21 +408,24 @@ int main()
 		unordered_set<string> *u = new unordered_set<string>(usrc);
 		//vector<string>
 		trie<string>          *t = new trie<string>(tsrc);
+		radix_trie<string>    *r = new radix_trie<string>(rsrc);
 
 		vector<string> source_cpy(source.cbegin(), source.cbegin() + i);
 		random_shuffle(begin(source_cpy), end(source_cpy));
 
 		outputFormat(i);
 		outputFormat("");
-		outputFormat(timeFunctionCall( [&]{ for(auto n = source_cpy.cbegin(); n < source_cpy.cend(); ++n) s->find(*n); } ).count() );
-		outputFormat(timeFunctionCall( [&]{ for(auto n = source_cpy.cbegin(); n < source_cpy.cend(); ++n) u->find(*n); } ).count() );
+		outputFormat(timeFunctionCall( [&]{ for(auto n = source_cpy.cbegin(); n < source_cpy.cend(); ++n) lookupSink += s->count(*n); } ).count() );
+		outputFormat(timeFunctionCall( [&]{ for(auto n = source_cpy.cbegin(); n < source_cpy.cend(); ++n) lookupSink += u->count(*n); } ).count() );
 		outputFormat("");
-        outputFormat(timeFunctionCall( [&]{ for(auto n = source_cpy.cbegin(); n < source_cpy.cend(); ++n) t->find(*n); } ).count() );
+        outputFormat(timeFunctionCall( [&]{ for(auto n = source_cpy.cbegin(); n < source_cpy.cend(); ++n) lookupSink += t->count(*n); } ).count() );
+		outputFormat(timeFunctionCall( [&]{ for(auto n = source_cpy.cbegin(); n < source_cpy.cend(); ++n) lookupSink += r->count(*n); } ).count() );
 		cout << endl;
 
 		delete s;
 		delete u;
 		delete t;
+		delete r;
 	}
 	cout << endl;
 
@@ -123,21 +436,213 @@ int main()
 		unordered_set<string> *u = new unordered_set<string>(usrc);
 		//vector<string>
 		trie<string>          *t = new trie<string>(tsrc);
+		radix_trie<string>    *r = new radix_trie<string>(rsrc);
 
 		vector<string> source_cpy(source.cbegin(), source.cend());
 		random_shuffle(begin(source_cpy), end(source_cpy));
 
 		outputFormat(i);
 		outputFormat("");
-		outputFormat(timeFunctionCall( [&]{ for(auto n = source_cpy.cbegin(); n < source_cpy.cend(); ++n) s->find(*n); } ).count() );
-		outputFormat(timeFunctionCall( [&]{ for(auto n = source_cpy.cbegin(); n < source_cpy.cend(); ++n) u->find(*n); } ).count() );
+		outputFormat(timeFunctionCall( [&]{ for(auto n = source_cpy.cbegin(); n < source_cpy.cend(); ++n) lookupSink += s->count(*n); } ).count() );
+		outputFormat(timeFunctionCall( [&]{ for(auto n = source_cpy.cbegin(); n < source_cpy.cend(); ++n) lookupSink += u->count(*n); } ).count() );
 		outputFormat("");
-        outputFormat(timeFunctionCall( [&]{ for(auto n = source_cpy.cbegin(); n < source_cpy.cend(); ++n) t->find(*n); } ).count() );
+        outputFormat(timeFunctionCall( [&]{ for(auto n = source_cpy.cbegin(); n < source_cpy.cend(); ++n) lookupSink += t->count(*n); } ).count() );
+		outputFormat(timeFunctionCall( [&]{ for(auto n = source_cpy.cbegin(); n < source_cpy.cend(); ++n) lookupSink += r->count(*n); } ).count() );
 		cout << endl;
 
 		delete s;
 		delete u;
 		delete t;
+		delete r;
+	}
+	cout << endl;
+
+	outputFormatHeader("FIND (FROM BUFFER)", {"iterations", "temporary string", "pointer and length"});
+	for(int i = 0; i <= largest; i += 100000) {
+		// The keys packed into one buffer, as if parsed out of a request
+		string buffer;
+		vector<pair<size_t, size_t>> spans;
+		for(auto n = source.cbegin(); n < source.cbegin() + i; ++n) {
+			spans.push_back({buffer.size(), n->size()});
+			buffer += *n;
+		}
+		random_shuffle(begin(spans), end(spans));
+
+		outputFormat(i);
+		outputFormat(timeFunctionCall( [&]{ for(auto& k: spans) lookupSink += tsrc.count(string(buffer, k.first, k.second)); } ).count() );
+		outputFormat(timeFunctionCall( [&]{ for(auto& k: spans) lookupSink += tsrc.count(buffer.data() + k.first, k.second); } ).count() );
+		cout << endl;
+	}
+	cout << endl;
+
+	outputFormatHeader("FIND (BATCHED)", {"iterations", "find loop", "find_many", "contains loop", "contains_many"});
+	for(int i = 0; i <= largest; i += 100000) {
+		vector<string> keys(source.cbegin(), source.cbegin() + i);
+		random_shuffle(begin(keys), end(keys));
+		const auto tend = tsrc.cend();
+
+		outputFormat(i);
+		outputFormat(timeFunctionCall( [&]{ for(auto& k: keys) lookupSink += tsrc.find(k) != tend; } ).count() );
+		outputFormat(timeFunctionCall( [&]{ tsrc.find_many(keys.cbegin(), keys.cend(), callEach([&](const trie<string>::const_iterator& it) { lookupSink += it != tend; })); } ).count() );
+		outputFormat(timeFunctionCall( [&]{ for(auto& k: keys) lookupSink += tsrc.contains(k); } ).count() );
+		outputFormat(timeFunctionCall( [&]{ tsrc.contains_many(keys.cbegin(), keys.cend(), callEach([&](bool found) { lookupSink += found; })); } ).count() );
+		cout << endl;
+	}
+	cout << endl;
+
+	outputFormatHeader("PAGING (KEY AT OFFSET)", {"iterations", "std::set advance", "gh403::trie nth"});
+	for(int i = 0; i <= 1000; i += 100) {
+		vector<size_t> offsets;
+		for(int n = 0; n < i; ++n)
+			offsets.push_back(rand() % ssrc.size());
+
+		outputFormat(i);
+		outputFormat(timeFunctionCall( [&]{ for(auto k: offsets) lookupSink += next(ssrc.begin(), k)->size(); } ).count() );
+		outputFormat(timeFunctionCall( [&]{ for(auto k: offsets) lookupSink += tsrc.nth(k)->size(); } ).count() );
+		cout << endl;
+	}
+	cout << endl;
+
+	outputFormatHeader("ITERATION (IN ORDER)", {"iterations", "std::set", "gh403::trie", "trie key_cursor"});
+	for(int i = 0; i <= largest; i += 100000) {
+		outputFormat(i);
+		outputFormat(timeFunctionCall( [&]{ auto it = ssrc.begin(); for(int n = 0; n < i; ++n, ++it) lookupSink += it->size(); } ).count() );
+		outputFormat(timeFunctionCall( [&]{ auto it = tsrc.begin(); for(int n = 0; n < i; ++n, ++it) lookupSink += it->size(); } ).count() );
+		outputFormat(timeFunctionCall( [&]{ auto c = tsrc.cursor(); for(int n = 0; n < i; ++n, c.next()) lookupSink += c.key().size(); } ).count() );
+		cout << endl;
+	}
+	cout << endl;
+
+	outputFormatHeader("FULL SCAN (VISITOR)", {"iterations", "range-for", "for_each", "parallel_for_each"});
+	for(int i = 0; i <= largest; i += 200000) {
+		trie<string> *t = new trie<string>(begin(source), begin(source) + i);
+
+		outputFormat(i);
+		outputFormat(timeFunctionCall( [&]{ size_t total = 0; for(const auto& k: *t) total += k.size(); lookupSink += total; } ).count() );
+		outputFormat(timeFunctionCall( [&]{ size_t total = 0; t->for_each([&](const string& k) { total += k.size(); }); lookupSink += total; } ).count() );
+		outputFormat(timeFunctionCall( [&]{
+			atomic<size_t> total{0};
+			t->parallel_for_each([&](const string& k) { total.fetch_add(k.size(), memory_order_relaxed); });
+			lookupSink += total;
+		} ).count() );
+		cout << endl;
+
+		delete t;
+	}
+	cout << endl;
+
+	outputFormatHeader("FUZZY FIND (EDIT DISTANCE)", {"queries", "1 edit, candidates", "1 edit, fuzzy_find", "2 edits, candidates", "2 edits, fuzzy_find"});
+	{
+		string alphabet;
+		for(const auto& word: source)
+			for(char c: word)
+				if(alphabet.find(c) == string::npos)
+					alphabet += c;
+
+		for(int i = 0; i <= 50; i += 10) {
+			outputFormat(i);
+			for(int distance = 1; distance <= 2; ++distance) {
+				outputFormat(timeFunctionCall( [&]{ for(int n = 0; n < i; ++n) lookupSink += countCandidates(tsrc, source[n], alphabet, distance); } ).count() );
+				outputFormat(timeFunctionCall( [&]{ for(int n = 0; n < i; ++n) lookupSink += tsrc.fuzzy_find(source[n], distance, true).size(); } ).count() );
+			}
+			cout << endl;
+		}
+	}
+	cout << endl;
+
+	outputFormatHeader("LONGEST PREFIX", {"iterations", "find per length", "longest_prefix_of", "prefixes_of"});
+	for(int i = 0; i <= largest; i += 100000) {
+		// Each input is a key with more text after it.
+		vector<string> inputs;
+		for(auto n = source.cbegin(); n < source.cbegin() + i; ++n)
+			inputs.push_back(*n + "/index.html");
+
+		outputFormat(i);
+		outputFormat(timeFunctionCall( [&]{
+			for(const auto& input: inputs)
+				for(size_t length = input.size() + 1; length-- > 0; )
+					if(tsrc.find(input.substr(0, length)) != tsrc.cend()) {
+						lookupSink += length;
+						break;
+					}
+		} ).count() );
+		outputFormat(timeFunctionCall( [&]{ for(const auto& input: inputs) lookupSink += tsrc.longest_prefix_of(input.data(), input.size()) != tsrc.cend(); } ).count() );
+		outputFormat(timeFunctionCall( [&]{ for(const auto& input: inputs) tsrc.prefixes_of(input.data(), input.size(), [&](size_t length) { lookupSink += length; }); } ).count() );
+		cout << endl;
+	}
+	cout << endl;
+
+	outputFormatHeader("SCAN (ALL KEYWORDS IN 64 MB OF TEXT)", {"keywords", "descent per offset", "aho_corasick", "aho_corasick GB/s"});
+	{
+		// Words from the whole list, so only some of them are keywords
+		string text;
+		srand(1);
+		while(text.size() < (64 << 20)) {
+			text += source[rand() % source.size()];
+			text += ' ';
+		}
+		const size_t chunk = 64 << 10;
+
+		for(int i = 1000; i <= 100000; i *= 10) {
+			trie<string> keywords(begin(source), begin(source) + i);
+			size_t longest = 0;
+			for(auto n = source.cbegin(); n < source.cbegin() + i; ++n)
+				longest = max(longest, n->size());
+			auto automaton = keywords.matcher();
+
+			outputFormat(i);
+			outputFormat(timeFunctionCall( [&]{
+				for(size_t at = 0; at < text.size(); ++at)
+					keywords.prefixes_of(text.data() + at, min(longest, text.size() - at), [&](size_t length) { lookupSink += length; });
+			} ).count() );
+			auto time = timeFunctionCall<microseconds>( [&]{
+				// As if from read(): the matches can span two chunks.
+				auto scan = automaton.start();
+				for(size_t at = 0; at < text.size(); at += chunk)
+					scan.scan(text.data() + at, min(chunk, text.size() - at), [&](size_t, size_t length) { lookupSink += length; });
+			} ).count();
+			outputFormat(time / 1000);
+			outputFormat(text.size() / (time * 1000.0));
+			cout << endl;
+		}
+	}
+	cout << endl;
+
+	outputFormatHeader("CONCURRENT (90% FIND, 10% INSERT / ERASE)", {"threads", "trie + mutex", "concurrent_trie"});
+	for(unsigned threads: {1u, 2u, 4u, 8u}) {
+		const size_t ops = 1000000;
+		trie<string>            *t = new trie<string>(tsrc);
+		concurrent_trie<string> *c = new concurrent_trie<string>;
+		for(auto n = source.cbegin(); n < source.cbegin() + largest; ++n)
+			c->insert(*n);
+		mutex tlock;
+
+		// The same scattered keys and the same mix for both
+		auto keyFor = [&](unsigned n, size_t k) -> const string& { return source[(n * ops + k) * 2654435761u % largest]; };
+		outputFormat(threads);
+		outputFormat(timeOnThreads(threads, [&](unsigned n) {
+			for(size_t k = 0; k < ops / threads; ++k) {
+				lock_guard<mutex> lock(tlock);
+				switch(k % 20) {
+					case 0:  t->insert(keyFor(n, k)); break;
+					case 1:  t->erase(keyFor(n, k)); break;
+					default: lookupSink += t->count(keyFor(n, k));
+				}
+			}
+		} ).count() );
+		outputFormat(timeOnThreads(threads, [&](unsigned n) {
+			for(size_t k = 0; k < ops / threads; ++k) {
+				switch(k % 20) {
+					case 0:  c->insert(keyFor(n, k)); break;
+					case 1:  c->erase(keyFor(n, k)); break;
+					default: lookupSink += c->count(keyFor(n, k));
+				}
+			}
+		} ).count() );
+		cout << endl;
+
+		delete t;
+		delete c;
 	}
 	cout << endl;
 
@@ -148,6 +653,7 @@ int main()
 		unordered_set<string> *u = new unordered_set<string>(usrc);
 		//vector<string>
 		trie<string>          *t = new trie<string>(tsrc);
+		radix_trie<string>    *r = new radix_trie<string>(rsrc);
 
 		vector<string> source_cpy(source.cbegin(), source.cbegin() + largest);
 		random_shuffle(begin(source_cpy), end(source_cpy));
@@ -158,11 +664,13 @@ int main()
 		outputFormat(timeFunctionCall( [&]{ for(auto n = source_cpy.cbegin(); n < source_cpy.cbegin() + i; ++n) u->find(*n); } ).count() );
 		outputFormat("");
         outputFormat(timeFunctionCall( [&]{ for(auto n = source_cpy.cbegin(); n < source_cpy.cbegin() + i; ++n) t->find(*n); } ).count() );
+		outputFormat(timeFunctionCall( [&]{ for(auto n = source_cpy.cbegin(); n < source_cpy.cbegin() + i; ++n) r->find(*n); } ).count() );
 		cout << endl;
 
 		delete s;
 		delete u;
 		delete t;
+		delete r;
 	}
 	cout << endl;
 
@@ -173,6 +681,7 @@ int main()
 		unordered_set<string> *u = new unordered_set<string>(usrc);
 		vector<string>        *v = new vector<string>(vsrc);
 		trie<string>          *t = new trie<string>(tsrc);
+		radix_trie<string>    *r = new radix_trie<string>(rsrc);
 
 		outputFormat(i);
 		outputFormat(timeFunctionCall( [&]{ auto it = l->begin(); for(int n = 0; n < i; ++n) it = l->erase(it); } ).count() );
@@ -182,6 +691,7 @@ int main()
 		if(i <= 20000) outputFormat(timeFunctionCall( [&]{ auto it = v->begin(); for(int n = 0; n < i; ++n) it = v->erase(it); } ).count() );
 		else           outputFormat("");
 		outputFormat(timeFunctionCall( [&]{ auto it = t->begin(); for(int n = 0; n < i; ++n) it = t->erase(it); } ).count() );
+		outputFormat(timeFunctionCall( [&]{ auto it = r->begin(); for(int n = 0; n < i; ++n) it = r->erase(it); } ).count() );
 
 		cout << endl;
 
@@ -190,6 +700,7 @@ int main()
 		delete u;
 		delete v;
 		delete t;
+		delete r;
 	}
 	cout << endl;
 
@@ -200,6 +711,7 @@ int main()
 		//unordered_set<string> // lacks iterator::operator--()
 		vector<string>        *v = new vector<string>(vsrc);
 		trie<string>          *t = new trie<string>(tsrc);
+		radix_trie<string>    *r = new radix_trie<string>(rsrc);
 
 		outputFormat(i);
 		outputFormat(timeFunctionCall( [&]{ auto it = l->end(); for(int n = 0; n < i; ++n) it = l->erase(--it); } ).count() );
@@ -207,13 +719,44 @@ int main()
 		outputFormat("");
 		outputFormat(timeFunctionCall( [&]{ auto it = v->end(); for(int n = 0; n < i; ++n) it = v->erase(--it); } ).count() );
 		outputFormat(timeFunctionCall( [&]{ auto it = t->end(); for(int n = 0; n < i; ++n) it = t->erase(--it); } ).count() );
+		outputFormat(timeFunctionCall( [&]{ auto it = r->end(); for(int n = 0; n < i; ++n) it = r->erase(--it); } ).count() );
+
+		cout << endl;
+
+		delete l;
+		delete s;
+		delete v;
+		delete t;
+		delete r;
+	}
+	cout << endl;
+
+	outputFormatHeader("DELETION (RANGE)");
+	for(int i = 0; i <= largest; i += 20000) {
+		list<string>          *l = new list<string>(lsrc);
+		set<string>           *s = new set<string>(ssrc);
+		unordered_set<string> *u = new unordered_set<string>(usrc);
+		vector<string>        *v = new vector<string>(vsrc);
+		trie<string>          *t = new trie<string>(tsrc);
+		radix_trie<string>    *r = new radix_trie<string>(rsrc);
+
+		// The first i keys, in one call
+		outputFormat(i);
+		outputFormat(timeFunctionCall( [&]{ l->erase(l->begin(), next(l->begin(), i)); } ).count() );
+		outputFormat(timeFunctionCall( [&]{ s->erase(s->begin(), next(s->begin(), i)); } ).count() );
+		outputFormat(timeFunctionCall( [&]{ u->erase(u->begin(), next(u->begin(), i)); } ).count() );
+		outputFormat(timeFunctionCall( [&]{ v->erase(v->begin(), next(v->begin(), i)); } ).count() );
+		outputFormat(timeFunctionCall( [&]{ t->erase(t->begin(), next(t->begin(), i)); } ).count() );
+		outputFormat(timeFunctionCall( [&]{ r->erase(r->begin(), next(r->begin(), i)); } ).count() );
 
 		cout << endl;
 
 		delete l;
 		delete s;
+		delete u;
 		delete v;
 		delete t;
+		delete r;
 	}
 	cout << endl;
 
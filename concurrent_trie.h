@@ -0,0 +1,332 @@
+// concurrent_trie.h - A set of keys that threads can read and change at once
+// Copyright (C) 2013  George Hilliard
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef CONCURRENT_TRIE_H
+#define CONCURRENT_TRIE_H
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <new>
+#include <iterator>
+#include <type_traits>
+
+#include "trie_simd.h"
+#include "trie_epoch.h"
+
+// A trie<T> that any number of threads may use at the same time, without a
+// lock around it.
+//
+// A node's children are kept in a block that never changes once it is
+// published; a writer builds a new block and swaps the pointer.  So contains()
+// only follows pointers and takes no locks: it is wait-free, apart from
+// pinning the epoch.  A writer locks only the node whose children or leaf flag
+// it changes (and, when erase() drops an empty node, that node's parent, always
+// parent first).  Replaced blocks and dropped nodes are freed through
+// trie_epoch once no reader can still hold them.
+//
+// Symbols must be trivially copyable.  There are no iterators: a scan could
+// not see a consistent set anyway.
+template<typename T>
+class concurrent_trie {
+	// data members and types
+	typedef typename T::value_type symbol;
+	typedef trie_symbol_search<symbol> search;
+	static_assert(std::is_trivially_copyable<symbol>::value, "concurrent_trie needs trivially copyable symbols");
+
+	struct node;
+	// count children, sorted by symbol: the child pointers, then the symbols
+	// (padded for the vectorized search).
+	struct block {
+		std::size_t count;
+
+		node** children() { return reinterpret_cast<node**>(this + 1); }
+		node* const* children() const { return reinterpret_cast<node* const*>(this + 1); }
+		symbol* symbols() { return reinterpret_cast<symbol*>(children() + count); }
+		const symbol* symbols() const { return reinterpret_cast<const symbol*>(children() + count); }
+	};
+	static_assert(alignof(symbol) <= alignof(node*), "symbols must fit after the child pointers");
+
+	struct node {
+		std::atomic<const block*> children{nullptr};
+		std::atomic<bool> is_leaf{false};
+		// Set, under lock, once the node is unlinked; writers that reach it
+		// afterwards start over.
+		bool dead = false;
+		std::mutex lock;
+	};
+
+	node root;
+	std::atomic<std::size_t> keys{0};
+	mutable trie_epoch epochs;
+
+public:
+	// misc. declarations
+	typedef T key_type;
+	typedef T value_type;
+	typedef size_t size_type;
+
+	// constructors
+	concurrent_trie() =default;
+	concurrent_trie(const concurrent_trie&) =delete;
+	concurrent_trie& operator=(const concurrent_trie&) =delete;
+	~concurrent_trie();
+
+	// Returns whether the key was new.
+	bool insert(const key_type&);
+	size_type erase(const key_type&);
+
+	bool contains(const key_type&) const;
+	size_type count(const key_type& key) const { return contains(key) ? 1 : 0; }
+
+	// Exact when no writer is running
+	size_type size() const { return keys.load(std::memory_order_relaxed); }
+	bool empty() const { return size() == 0; }
+
+private:
+	static block* new_block(std::size_t count) {
+		block* b = static_cast<block*>(::operator new(sizeof(block) + count * sizeof(node*) + search::padded(count) * sizeof(symbol)));
+		b->count = count;
+		return b;
+	}
+	static void free_block(void* b) { ::operator delete(b); }
+	static void free_node(void* n) { delete static_cast<node*>(n); }
+	static void delete_subtree(node*);
+
+	// The child of n for s, or nullptr
+	static node* child(const node* n, const symbol& s, std::memory_order order = std::memory_order_acquire) {
+		const block* b = n->children.load(order);
+		if(b == nullptr)
+			return nullptr;
+		auto i = search::find(b->symbols(), b->count, s);
+		return i == search::npos ? nullptr : b->children()[i];
+	}
+	// Copies of b with a child added or removed
+	static block* with_child(const block* b, const symbol&, node*);
+	static block* without_child(const block* b, const symbol&);
+	template<typename InputIt> static node* new_chain(InputIt, InputIt);
+};
+
+template<typename T>
+concurrent_trie<T>::~concurrent_trie()
+{
+	if(const block* b = root.children.load())
+		for(std::size_t i = 0; i < b->count; ++i)
+			delete_subtree(b->children()[i]);
+	free_block(const_cast<block*>(root.children.load()));
+}
+
+template<typename T>
+void concurrent_trie<T>::delete_subtree(node* n)
+{
+	if(const block* b = n->children.load()) {
+		for(std::size_t i = 0; i < b->count; ++i)
+			delete_subtree(b->children()[i]);
+		free_block(const_cast<block*>(b));
+	}
+	delete n;
+}
+
+template<typename T>
+auto concurrent_trie<T>::with_child(const block* b, const symbol& s, node* c) -> block*
+{
+	std::size_t count = b == nullptr ? 0 : b->count;
+	std::size_t at = b == nullptr ? 0 : search::lower_bound(b->symbols(), count, s);
+	block* fresh = new_block(count + 1);
+	for(std::size_t i = 0, j = 0; i <= count; ++i) {
+		if(i == at) {
+			fresh->symbols()[i] = s;
+			fresh->children()[i] = c;
+		}
+		else {
+			fresh->symbols()[i] = b->symbols()[j];
+			fresh->children()[i] = b->children()[j];
+			++j;
+		}
+	}
+	return fresh;
+}
+
+template<typename T>
+auto concurrent_trie<T>::without_child(const block* b, const symbol& s) -> block*
+{
+	// The last child leaves no block at all.
+	if(b->count == 1)
+		return nullptr;
+	std::size_t at = search::find(b->symbols(), b->count, s);
+	block* fresh = new_block(b->count - 1);
+	for(std::size_t i = 0, j = 0; j < b->count; ++j) {
+		if(j == at)
+			continue;
+		fresh->symbols()[i] = b->symbols()[j];
+		fresh->children()[i] = b->children()[j];
+		++i;
+	}
+	return fresh;
+}
+
+template<typename T>
+template<typename InputIt>
+auto concurrent_trie<T>::new_chain(InputIt first, InputIt last) -> node*
+{
+	// A node for every symbol in [first, last) below a new top node, the
+	// last of them a leaf.  Nobody else can see them until they are linked in.
+	node* top = new node;
+	try {
+		node* n = top;
+		for(; first != last; ++first) {
+			node* c = new node;
+			block* b;
+			try {
+				b = with_child(nullptr, *first, c);
+			}
+			catch(...) {
+				delete c;
+				throw;
+			}
+			n->children.store(b, std::memory_order_relaxed);
+			n = c;
+		}
+		n->is_leaf.store(true, std::memory_order_relaxed);
+	}
+	catch(...) {
+		delete_subtree(top);
+		throw;
+	}
+	return top;
+}
+
+template<typename T>
+bool concurrent_trie<T>::insert(const key_type& key)
+{
+	auto pinned = epochs.pin();
+	for(;;) {
+		// Go as far down as the key already exists, without locking.
+		node* n = &root;
+		auto inputIt = key.cbegin();
+		for(; inputIt != key.cend(); ++inputIt) {
+			node* c = child(n, *inputIt);
+			if(c == nullptr)
+				break;
+			n = c;
+		}
+
+		std::lock_guard<std::mutex> lock(n->lock);
+		if(n->dead)
+			// Unlinked while we weren't holding it
+			continue;
+		if(inputIt == key.cend()) {
+			if(n->is_leaf.load(std::memory_order_relaxed))
+				return false;
+			n->is_leaf.store(true, std::memory_order_release);
+			keys.fetch_add(1, std::memory_order_relaxed);
+			return true;
+		}
+		// Only writers holding the lock change the children, so this is current.
+		if(child(n, *inputIt, std::memory_order_relaxed) != nullptr)
+			// Someone added it since we looked.
+			continue;
+
+		node* chain = new_chain(std::next(inputIt), key.cend());
+		const block* old = n->children.load(std::memory_order_relaxed);
+		block* fresh;
+		try {
+			fresh = with_child(old, *inputIt, chain);
+		}
+		catch(...) {
+			delete_subtree(chain);
+			throw;
+		}
+		n->children.store(fresh, std::memory_order_release);
+		if(old != nullptr)
+			epochs.retire(const_cast<block*>(old), free_block);
+		keys.fetch_add(1, std::memory_order_relaxed);
+		return true;
+	}
+}
+
+template<typename T>
+auto concurrent_trie<T>::erase(const key_type& key) -> size_type
+{
+	auto pinned = epochs.pin();
+	std::vector<node*> path;
+	for(;;) {
+		path.clear();
+		node* n = &root;
+		for(auto inputIt = key.cbegin(); inputIt != key.cend(); ++inputIt) {
+			path.push_back(n);
+			n = child(n, *inputIt);
+			if(n == nullptr)
+				return 0;
+		}
+
+		std::unique_lock<std::mutex> lock(n->lock);
+		if(n->dead)
+			continue;
+		if(!n->is_leaf.load(std::memory_order_relaxed))
+			return 0;
+		n->is_leaf.store(false, std::memory_order_release);
+		keys.fetch_sub(1, std::memory_order_relaxed);
+
+		// Drop the nodes left holding no key, bottom up.  The parent must be
+		// locked first, so let go of the node and check it again after.
+		for(size_t depth = path.size(); depth > 0; --depth) {
+			if(n->is_leaf.load(std::memory_order_relaxed) || n->children.load(std::memory_order_relaxed) != nullptr)
+				break;
+			lock.unlock();
+			node* parent = path[depth - 1];
+			std::unique_lock<std::mutex> parent_lock(parent->lock);
+			lock.lock();
+			if(n->dead || n->is_leaf.load(std::memory_order_relaxed) || n->children.load(std::memory_order_relaxed) != nullptr)
+				break;
+			const block* old = parent->children.load(std::memory_order_relaxed);
+			block* fresh;
+			try {
+				fresh = without_child(old, *std::next(key.cbegin(), depth - 1));
+			}
+			catch(const std::bad_alloc&) {
+				// The key is gone; an empty node left behind does no harm.
+				break;
+			}
+			// A live node is always linked in, and so is its parent.
+			n->dead = true;
+			parent->children.store(fresh, std::memory_order_release);
+			epochs.retire(const_cast<block*>(old), free_block);
+			lock.unlock();
+			epochs.retire(n, free_node);
+			n = parent;
+			lock = std::move(parent_lock);
+		}
+		return 1;
+	}
+}
+
+template<typename T>
+bool concurrent_trie<T>::contains(const key_type& key) const
+{
+	auto pinned = epochs.pin();
+	const node* n = &root;
+	for(auto inputIt = key.cbegin(); inputIt != key.cend(); ++inputIt) {
+		n = child(n, *inputIt);
+		if(n == nullptr)
+			return false;
+	}
+	return n->is_leaf.load(std::memory_order_acquire);
+}
+
+#endif
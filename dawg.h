@@ -0,0 +1,311 @@
+// dawg.h - A minimal acyclic automaton for a set of keys
+// Copyright (C) 2013  George Hilliard
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef DAWG_H
+#define DAWG_H
+
+#include <stack>
+#include <vector>
+#include <cstdint>
+#include <utility>
+#include <functional>
+#include <stdexcept>
+#include <unordered_set>
+
+#include "trie.h"
+
+// A read-only set of keys stored as a directed acyclic word graph: a trie in
+// which equivalent subtrees, those holding the same set of suffixes, are
+// stored once.  Keys that share endings ("-ing", ".example.com") then share
+// states as well as prefixes.
+//
+// It is built from sorted keys one at a time (Daciuk et al., 2000), so the
+// full trie never exists.  trie<T>::minimize() builds one from a trie.
+// Symbols need std::hash.
+template<typename T>
+class dawg {
+	// data members and types
+	typedef typename T::value_type symbol;
+	typedef trie_symbol_search<symbol> search;
+
+	// A state's outgoing edges are labels[first, first + edges) and the
+	// matching targets, sorted by label.
+	struct state {
+		uint32_t first;
+		uint32_t edges : 31;
+		uint32_t final : 1;
+	};
+	static constexpr uint32_t root = 0;
+
+	std::vector<state> states;
+	std::vector<symbol> labels;
+	std::vector<uint32_t> targets;
+	size_t keys = 0;
+	size_t merged = 0;
+
+public:
+	// misc. declarations
+	class iterator;
+	typedef T key_type;
+	typedef T value_type;
+	typedef size_t size_type;
+	typedef iterator const_iterator;
+
+	// constructors
+	dawg();
+	// The keys must be sorted in the trie's order; duplicates are skipped.
+	template<typename InputIt> dawg(InputIt, InputIt);
+
+	// iterators and related
+	iterator begin() const;
+	iterator end() const;
+	const_iterator cbegin() const { return begin(); }
+	const_iterator cend() const { return end(); }
+
+	// other members
+	bool empty() const { return keys == 0; }
+	size_type size() const { return keys; }
+	// States stored, and states a trie would have had that were merged into them
+	size_type state_count() const { return states.size(); }
+	size_type merged_count() const { return merged; }
+	// Bytes taken by the arrays
+	size_type memory_usage() const {
+		return sizeof(*this) + states.capacity() * sizeof(state) + labels.capacity() * sizeof(symbol) +
+		       targets.capacity() * sizeof(uint32_t);
+	}
+
+	const_iterator find(const key_type&) const;
+	size_type count(const key_type& key) const { return contains(key) ? 1 : 0; }
+	bool contains(const key_type&) const;
+
+	void swap(dawg& other) {
+		states.swap(other.states);
+		labels.swap(other.labels);
+		targets.swap(other.targets);
+		std::swap(keys, other.keys);
+		std::swap(merged, other.merged);
+	}
+	static void swap(dawg& a, dawg& b) { a.swap(b); }
+
+private:
+	// A state on the path of the last key added, which may still change
+	struct pending {
+		bool final;
+		std::vector<std::pair<symbol, uint32_t>> edges;
+	};
+	// Hashes and compares stored states by their edges, so equivalent states
+	// can be found.
+	struct state_hash {
+		const dawg* d;
+		size_t operator()(uint32_t) const;
+	};
+	struct state_equal {
+		const dawg* d;
+		bool operator()(uint32_t, uint32_t) const;
+	};
+	typedef std::unordered_set<uint32_t, state_hash, state_equal> registry;
+
+	uint32_t add_state(const pending&, registry&);
+
+	// Index of the edge of s labeled c, relative to its first, or npos
+	uint32_t find_edge(const state& s, const symbol& c) const {
+		return s.edges == 0 ? search::npos : search::find(labels.data() + s.first, s.edges, c);
+	}
+};
+
+// Definition of dawg<T>::iterator
+#include "dawg_iterator.h"
+
+template<typename T>
+constexpr uint32_t dawg<T>::root;
+
+template<typename T, typename Alloc, typename Mapped>
+dawg<T> trie<T, Alloc, Mapped>::minimize() const
+{
+	static_assert(!stores_values, "a dawg has no values");
+	return dawg<T>(cbegin(), cend());
+}
+
+template<typename T>
+dawg<T>::dawg() :
+	states(1, state{0, 0, 0})
+{
+}
+
+template<typename T>
+template<typename InputIt>
+dawg<T>::dawg(InputIt first, InputIt last) :
+	dawg()
+{
+	// path holds the states along the last key.  When a key leaves some of
+	// them behind, they can't change any more, so each is stored, or replaced
+	// by an equivalent state already stored.  Their children are always
+	// stored first, so equivalent states have the very same targets.
+	registry stored(1024, state_hash{this}, state_equal{this});
+	std::vector<pending> path(1, pending{false, {}});
+	size_t depth = 0;  // of the last key
+	bool started = false;
+
+	auto store_below = [&](size_t d) {
+		for(; depth > d; --depth)
+			path[depth - 1].edges.back().second = add_state(path[depth], stored);
+	};
+
+	for(; first != last; ++first) {
+		const auto& key = *first;
+		auto inputIt = key.cbegin();
+		size_t d = 0;
+		while(d < depth && inputIt != key.cend() && *inputIt == path[d].edges.back().first) {
+			++inputIt;
+			++d;
+		}
+		if(started) {
+			if(inputIt == key.cend()) {
+				if(d == depth)
+					continue;
+				throw std::invalid_argument("dawg: keys are not sorted");
+			}
+			if(d < depth && !(path[d].edges.back().first < *inputIt))
+				throw std::invalid_argument("dawg: keys are not sorted");
+		}
+
+		store_below(d);
+		for(; inputIt != key.cend(); ++inputIt, ++d) {
+			path[d].edges.push_back({*inputIt, 0});
+			if(path.size() == d + 1)
+				path.push_back(pending{false, {}});
+			else {
+				path[d + 1].final = false;
+				path[d + 1].edges.clear();
+			}
+		}
+		path[d].final = true;
+		depth = d;
+		started = true;
+		++keys;
+	}
+
+	store_below(0);
+	// The root can't be equivalent to any other state; it has the place saved for it.
+	states[root] = state{static_cast<uint32_t>(labels.size()), static_cast<uint32_t>(path[0].edges.size()), path[0].final};
+	for(const auto& e: path[0].edges) {
+		labels.push_back(e.first);
+		targets.push_back(e.second);
+	}
+
+	// The vectorized search may read up to a vector's width past the last label.
+	labels.resize(labels.size() + 32);
+	states.shrink_to_fit();
+	labels.shrink_to_fit();
+	targets.shrink_to_fit();
+}
+
+template<typename T>
+uint32_t dawg<T>::add_state(const pending& p, registry& stored)
+{
+	// Stores p, or returns the equivalent state if one is already stored.
+	uint32_t id = states.size();
+	states.push_back(state{static_cast<uint32_t>(labels.size()), static_cast<uint32_t>(p.edges.size()), p.final});
+	for(const auto& e: p.edges) {
+		labels.push_back(e.first);
+		targets.push_back(e.second);
+	}
+
+	auto found = stored.find(id);
+	if(found != stored.end()) {
+		states.pop_back();
+		labels.resize(labels.size() - p.edges.size());
+		targets.resize(targets.size() - p.edges.size());
+		++merged;
+		return *found;
+	}
+	stored.insert(id);
+	return id;
+}
+
+template<typename T>
+size_t dawg<T>::state_hash::operator()(uint32_t id) const
+{
+	const state& s = d->states[id];
+	size_t h = s.final;
+	for(uint32_t i = s.first; i < s.first + s.edges; ++i) {
+		h = h * 31 + std::hash<symbol>()(d->labels[i]);
+		h = h * 31 + d->targets[i];
+	}
+	return h;
+}
+
+template<typename T>
+bool dawg<T>::state_equal::operator()(uint32_t a, uint32_t b) const
+{
+	const state& s = d->states[a];
+	const state& t = d->states[b];
+	if(s.final != t.final || s.edges != t.edges)
+		return false;
+	for(uint32_t i = 0; i < s.edges; ++i)
+		if(!(d->labels[s.first + i] == d->labels[t.first + i]) || d->targets[s.first + i] != d->targets[t.first + i])
+			return false;
+	return true;
+}
+
+template<typename T>
+auto dawg<T>::begin() const -> iterator
+{
+	return {this, root};
+}
+
+template<typename T>
+auto dawg<T>::end() const -> iterator
+{
+	std::stack<typename iterator::state> temp;
+	temp.push({root, states[root].edges});
+	return {this, std::move(temp), T{}, true};
+}
+
+template<typename T>
+auto dawg<T>::find(const key_type& key) const -> const_iterator
+{
+	iterator it{this, std::stack<typename iterator::state>{}, key, false};
+	uint32_t s = root;
+
+	for(auto inputIt = key.cbegin(); inputIt != key.cend(); ++inputIt) {
+		uint32_t index = find_edge(states[s], *inputIt);
+		if(index == search::npos)
+			return cend();
+		it.parents.push({s, index});
+		s = targets[states[s].first + index];
+	}
+	if(!states[s].final)
+		return cend();
+	it.parents.push({s, iterator::npos});
+	return it;
+}
+
+template<typename T>
+bool dawg<T>::contains(const key_type& key) const
+{
+	uint32_t s = root;
+
+	for(auto inputIt = key.cbegin(); inputIt != key.cend(); ++inputIt) {
+		uint32_t index = find_edge(states[s], *inputIt);
+		if(index == search::npos)
+			return false;
+		s = targets[states[s].first + index];
+	}
+	return states[s].final;
+}
+
+#endif
@@ -0,0 +1,137 @@
+#ifndef DAWG_ITERATOR_H
+#define DAWG_ITERATOR_H
+
+#include <iterator>
+
+#include "dawg.h"
+
+template<typename T>
+class dawg<T>::iterator : public std::iterator<std::bidirectional_iterator_tag, T> {
+	friend class dawg<T>;
+
+	// data members and types
+
+	// Works like trie<T>::iterator.  Each state is a state of the automaton on
+	// the path and the index of the edge being followed out of it, or npos
+	// for the key ending there.  Every key ends on a final state, so the top
+	// state is always at npos.
+	static constexpr uint32_t npos = dawg<T>::search::npos;
+	struct state {
+		uint32_t s;
+		uint32_t index;
+
+		bool operator==(const state& other) const {
+			return s == other.s && index == other.index;
+		}
+	};
+
+	const dawg<T>* automaton;
+	std::stack<state> parents;
+	T built;
+	bool at_end;
+
+public:
+	typedef const T value_type;
+	iterator() =default;
+	iterator(const dawg<T>* automaton, uint32_t s) : automaton{automaton}, at_end{false} {
+		parents.push({s, automaton->states[s].final ? npos : 0});
+		fall_down();
+	}
+
+	const T& operator*() const { return built; }
+	const T* operator->() const { return &built; }
+
+	iterator& operator++() {
+		if(parents.top().index == npos)
+			parents.top().index = 0;
+		else
+			leave_child();
+		fall_down();
+		return *this;
+	}
+	iterator operator++(int) {
+		iterator temp {*this};
+		++*this;
+		return temp;
+	}
+	iterator& operator--() {
+		if(at_end)
+			at_end = false;
+		else {
+			parents.pop();
+			built.pop_back();
+		}
+		climb_back();
+		return *this;
+	}
+	iterator operator--(int) {
+		iterator temp {*this};
+		--*this;
+		return temp;
+	}
+
+	bool operator==(const iterator& other) const {
+		// Keys that share a suffix end on the same state, so the state alone
+		// doesn't tell positions apart; the key does.
+		return at_end == other.at_end && (at_end || (parents.top() == other.parents.top() && built == other.built));
+	}
+	bool operator!=(const iterator& other) const { return !operator==(other); }
+private:
+	iterator(const dawg<T>* automaton, std::stack<state>&& parents, const T& built, bool at_end) :
+		automaton{automaton}, parents{std::move(parents)}, built{built}, at_end{at_end} {}
+
+	void inline leave_child() {
+		built.pop_back();
+		++parents.top().index;
+	}
+	// Moves forward from the top state to the first key at or after it.
+	void fall_down() {
+		for(;;) {
+			state& top = parents.top();
+			if(top.index == npos)
+				return;
+			const typename dawg<T>::state& from = automaton->states[top.s];
+			if(top.index == from.edges) {
+				if(parents.size() == 1) {
+					at_end = true;
+					return;
+				}
+				parents.pop();
+				leave_child();
+				continue;
+			}
+			built.push_back(automaton->labels[from.first + top.index]);
+			uint32_t to = automaton->targets[from.first + top.index];
+			parents.push({to, automaton->states[to].final ? npos : 0});
+		}
+	}
+	// Moves backward from the top state, whose edge has already been left,
+	// to the last key before it.
+	void climb_back() {
+		while(parents.top().index == 0) {
+			if(automaton->states[parents.top().s].final) {
+				parents.top().index = npos;
+				return;
+			}
+			parents.pop();
+			built.pop_back();
+		}
+		--parents.top().index;
+		for(;;) {
+			const state& top = parents.top();
+			const typename dawg<T>::state& from = automaton->states[top.s];
+			built.push_back(automaton->labels[from.first + top.index]);
+			uint32_t to = automaton->targets[from.first + top.index];
+			// A state with no edges is always final.
+			uint32_t edges = automaton->states[to].edges;
+			parents.push({to, edges == 0 ? npos : edges - 1});
+			if(edges == 0)
+				return;
+		}
+	}
+};
+
+template<typename T>
+constexpr uint32_t dawg<T>::iterator::npos;
+
+#endif
@@ -0,0 +1,378 @@
+// double_array_trie.h - An immutable double-array trie
+// Copyright (C) 2013  George Hilliard
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef DOUBLE_ARRAY_TRIE_H
+#define DOUBLE_ARRAY_TRIE_H
+
+#include <stack>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+#include <type_traits>
+
+#include "trie.h"
+
+// A read-only trie of byte-symbol keys, made by trie<T>::freeze().  Each
+// state is a cell of one array; the child of state s for symbol code c is
+// cell base[s] + c, which really is s's child only if its check is s.  So a
+// lookup costs one array access per symbol, and no pointers are followed.
+//
+// Code 0 marks the end of a key, so a state whose own key is stored has a
+// child with code 0.  A state with only one key below it keeps the rest of
+// that key in the tail array instead of a chain of states; its base is
+// negative and gives the tail record's offset.
+template<typename T>
+class double_array_trie {
+	// data members and types
+	typedef typename T::value_type symbol;
+	static_assert(trie_byte_symbol<symbol>::value, "double_array_trie needs byte-sized symbols");
+
+	struct cell {
+		int32_t base;   // > 0 for a state with children, < 0 for a tail
+		int32_t check;  // the parent state, or unused
+	};
+	// Codes of a state's first child and of its next sibling, for iteration
+	struct link {
+		uint16_t first;
+		uint16_t next;
+	};
+
+	static constexpr int32_t unused = -1;
+	static constexpr uint16_t none = 0xffff;
+	static constexpr int32_t root = 0;
+
+	std::vector<cell> cells;
+	std::vector<link> links;
+	// Records of a length (4 bytes, unaligned) followed by that many symbols.
+	// The record at offset 0 is empty and shared.
+	std::vector<unsigned char> tail;
+	size_t keys = 0;
+
+	// While building, the free cells form a list in index order, so placing a
+	// state skips over the cells already taken.
+	struct free_link {
+		int32_t prev;
+		int32_t next;
+	};
+	std::vector<free_link> free_cells;
+	int32_t first_free = -1;
+	int32_t last_free = -1;
+
+public:
+	// misc. declarations
+	class iterator;
+	typedef T key_type;
+	typedef T value_type;
+	typedef size_t size_type;
+	typedef iterator const_iterator;
+
+	// constructors
+	double_array_trie();
+	template<typename Alloc> explicit double_array_trie(const trie<T, Alloc>&);
+
+	// iterators and related
+	iterator begin() const;
+	iterator end() const;
+	const_iterator cbegin() const { return begin(); }
+	const_iterator cend() const { return end(); }
+
+	// other members
+	bool empty() const { return keys == 0; }
+	size_type size() const { return keys; }
+	// Bytes taken by the arrays
+	size_type memory_usage() const {
+		return sizeof(*this) + cells.capacity() * sizeof(cell) + links.capacity() * sizeof(link) + tail.capacity();
+	}
+
+	const_iterator find(const key_type&) const;
+	size_type count(const key_type& key) const { return contains(key) ? 1 : 0; }
+	bool contains(const key_type&) const;
+
+	void swap(double_array_trie& other) {
+		cells.swap(other.cells);
+		links.swap(other.links);
+		tail.swap(other.tail);
+		std::swap(keys, other.keys);
+	}
+	static void swap(double_array_trie& a, double_array_trie& b) { a.swap(b); }
+
+private:
+	// Codes keep the symbols' order, after the end-of-key code 0.
+	static uint16_t code(const symbol& s) {
+		return (static_cast<unsigned char>(s) ^ (std::is_signed<symbol>::value ? 0x80 : 0)) + 1;
+	}
+	static symbol symbol_of(uint16_t c) {
+		return static_cast<symbol>(static_cast<unsigned char>((c - 1) ^ (std::is_signed<symbol>::value ? 0x80 : 0)));
+	}
+
+	// The child of s with code c, or unused
+	int32_t child(int32_t s, uint16_t c) const {
+		int32_t t = cells[s].base + c;
+		return static_cast<size_t>(t) < cells.size() && cells[t].check == s ? t : unused;
+	}
+	uint32_t tail_length(int32_t s) const {
+		uint32_t n;
+		std::memcpy(&n, tail.data() - cells[s].base - 1, sizeof(n));
+		return n;
+	}
+	const unsigned char* tail_symbols(int32_t s) const { return tail.data() - cells[s].base - 1 + sizeof(uint32_t); }
+	template<typename InputIt> bool tail_matches(int32_t, InputIt, InputIt) const;
+
+	void grow(size_t);
+	void take(int32_t);
+	int32_t find_base(const uint16_t*, size_t);
+	template<typename Node> void build(const Node&, int32_t);
+	template<typename Node> int32_t add_tail(const Node*);
+};
+
+// Definition of double_array_trie<T>::iterator
+#include "double_array_trie_iterator.h"
+
+template<typename T>
+constexpr int32_t double_array_trie<T>::unused;
+template<typename T>
+constexpr uint16_t double_array_trie<T>::none;
+template<typename T>
+constexpr int32_t double_array_trie<T>::root;
+
+template<typename T, typename Alloc, typename Mapped>
+double_array_trie<T> trie<T, Alloc, Mapped>::freeze() const
+{
+	static_assert(!stores_values, "a double_array_trie has no values");
+	return double_array_trie<T>(*this);
+}
+
+template<typename T>
+double_array_trie<T>::double_array_trie() :
+	cells(1, cell{0, unused}), links(1, link{none, none}), tail(sizeof(uint32_t), 0)
+{
+	// The root is nobody's child, but its cell is taken.
+	cells[root].check = unused - 1;
+}
+
+template<typename T>
+template<typename Alloc>
+double_array_trie<T>::double_array_trie(const trie<T, Alloc>& from) :
+	double_array_trie()
+{
+	keys = from.size();
+	build(from.root, root);
+
+	free_cells.clear();
+	free_cells.shrink_to_fit();
+
+	// Drop the unused cells at the end.
+	size_t used = cells.size();
+	while(used > 1 && cells[used - 1].check == unused)
+		--used;
+	cells.resize(used);
+	links.resize(used);
+	cells.shrink_to_fit();
+	links.shrink_to_fit();
+	tail.shrink_to_fit();
+}
+
+template<typename T>
+void double_array_trie<T>::grow(size_t n)
+{
+	if(n <= cells.size())
+		return;
+	int32_t old = cells.size();
+	n = std::max(n, cells.size() * 2);
+	cells.resize(n, cell{0, unused});
+	links.resize(n, link{none, none});
+
+	// Append the new cells to the free list.
+	free_cells.resize(n);
+	for(int32_t i = old; i < static_cast<int32_t>(n); ++i)
+		free_cells[i] = free_link{i - 1, i + 1};
+	free_cells[old].prev = last_free;
+	free_cells[n - 1].next = -1;
+	if(last_free < 0)
+		first_free = old;
+	else
+		free_cells[last_free].next = old;
+	last_free = n - 1;
+}
+
+template<typename T>
+void double_array_trie<T>::take(int32_t t)
+{
+	// Marks free cell t as used by taking it off the free list.
+	const free_link& l = free_cells[t];
+	if(l.prev < 0)
+		first_free = l.next;
+	else
+		free_cells[l.prev].next = l.next;
+	if(l.next < 0)
+		last_free = l.prev;
+	else
+		free_cells[l.next].prev = l.prev;
+}
+
+template<typename T>
+int32_t double_array_trie<T>::find_base(const uint16_t* codes, size_t n)
+{
+	// The first base where every code lands on a free cell.  codes is sorted.
+	for(int32_t p = first_free; ; p = free_cells[p].next) {
+		if(p < 0) {
+			p = cells.size();
+			grow(p + 1);
+		}
+		int32_t b = p - codes[0];
+		if(b < 1)
+			continue;
+		grow(b + codes[n - 1] + 1);
+		size_t i = 1;
+		while(i < n && cells[b + codes[i]].check == unused)
+			++i;
+		if(i == n)
+			return b;
+	}
+}
+
+template<typename T>
+template<typename Node>
+void double_array_trie<T>::build(const Node& n, int32_t s)
+{
+	// Places the children of n below state s, then everything under them.
+	uint16_t codes[257];
+	size_t count = 0;
+	if(n.is_leaf)
+		codes[count++] = 0;
+	for(auto slot = n.children.first(); slot != n.children.end_slot(); slot = n.children.next(slot))
+		codes[count++] = code(n.children.symbol(slot));
+	if(count == 0)
+		return;
+
+	int32_t b = find_base(codes, count);
+	cells[s].base = b;
+	links[s].first = codes[0];
+	for(size_t i = 0; i < count; ++i) {
+		take(b + codes[i]);
+		cells[b + codes[i]].check = s;
+		links[b + codes[i]].next = i + 1 < count ? codes[i + 1] : none;
+	}
+
+	for(auto slot = n.children.first(); slot != n.children.end_slot(); slot = n.children.next(slot)) {
+		int32_t t = b + code(n.children.symbol(slot));
+		const Node* child = n.children.child(slot);
+		if(child == nullptr || child->count == 1)
+			cells[t].base = add_tail(child);
+		else
+			build(*child, t);
+	}
+}
+
+template<typename T>
+template<typename Node>
+int32_t double_array_trie<T>::add_tail(const Node* n)
+{
+	// n holds a single key; returns the base for a tail with the rest of it.
+	if(n == nullptr)
+		return -1;
+	size_t offset = tail.size();
+	tail.resize(offset + sizeof(uint32_t));
+	while(n != nullptr && !n->is_leaf) {
+		auto slot = n->children.first();
+		tail.push_back(static_cast<unsigned char>(n->children.symbol(slot)));
+		n = n->children.child(slot);
+	}
+	uint32_t length = tail.size() - offset - sizeof(uint32_t);
+	if(length == 0) {
+		tail.resize(offset);
+		return -1;
+	}
+	std::memcpy(&tail[offset], &length, sizeof(length));
+	return -static_cast<int32_t>(offset) - 1;
+}
+
+template<typename T>
+template<typename InputIt>
+bool double_array_trie<T>::tail_matches(int32_t s, InputIt first, InputIt last) const
+{
+	// Whether [first, last) is the rest of the key in s's tail.
+	uint32_t length = tail_length(s);
+	const unsigned char* rest = tail_symbols(s);
+	for(uint32_t i = 0; i < length; ++i, ++first)
+		if(first == last || static_cast<unsigned char>(*first) != rest[i])
+			return false;
+	return first == last;
+}
+
+template<typename T>
+auto double_array_trie<T>::begin() const -> iterator
+{
+	return {this};
+}
+
+template<typename T>
+auto double_array_trie<T>::end() const -> iterator
+{
+	std::stack<typename iterator::state> temp;
+	temp.push({root, none});
+	return {this, std::move(temp), T{}, true};
+}
+
+template<typename T>
+auto double_array_trie<T>::find(const key_type& key) const -> const_iterator
+{
+	iterator it{this, std::stack<typename iterator::state>{}, key, false};
+	int32_t s = root;
+
+	for(auto inputIt = key.cbegin(); inputIt != key.cend(); ++inputIt) {
+		if(cells[s].base < 0) {
+			if(!tail_matches(s, inputIt, key.cend()))
+				return cend();
+			it.parents.push({s, iterator::in_tail});
+			return it;
+		}
+		int32_t t = child(s, code(*inputIt));
+		if(t == unused)
+			return cend();
+		it.parents.push({s, code(*inputIt)});
+		s = t;
+	}
+
+	if(cells[s].base < 0) {
+		if(tail_length(s) != 0)
+			return cend();
+		it.parents.push({s, iterator::in_tail});
+	}
+	else if(child(s, 0) == unused)
+		return cend();
+	else
+		it.parents.push({s, 0});
+	return it;
+}
+
+template<typename T>
+bool double_array_trie<T>::contains(const key_type& key) const
+{
+	int32_t s = root;
+
+	for(auto inputIt = key.cbegin(); inputIt != key.cend(); ++inputIt) {
+		if(cells[s].base < 0)
+			return tail_matches(s, inputIt, key.cend());
+		s = child(s, code(*inputIt));
+		if(s == unused)
+			return false;
+	}
+	return cells[s].base < 0 ? tail_length(s) == 0 : child(s, 0) != unused;
+}
+
+#endif
@@ -0,0 +1,158 @@
+#ifndef DOUBLE_ARRAY_TRIE_ITERATOR_H
+#define DOUBLE_ARRAY_TRIE_ITERATOR_H
+
+#include <iterator>
+
+#include "double_array_trie.h"
+
+template<typename T>
+class double_array_trie<T>::iterator : public std::iterator<std::bidirectional_iterator_tag, T> {
+	friend class double_array_trie<T>;
+
+	// data members and types
+
+	// Each state is a state of the trie on the path and the code of the child
+	// being followed out of it.  The top state is either at code 0, which ends
+	// a key, or is a tail state, whose tail is at the end of built.
+	static constexpr uint16_t in_tail = 0xfffe;
+	struct state {
+		int32_t s;
+		uint16_t code;
+
+		bool operator==(const state& other) const {
+			return s == other.s && code == other.code;
+		}
+	};
+
+	const double_array_trie<T>* da;
+	std::stack<state> parents;
+	T built;
+	bool at_end;
+
+public:
+	typedef const T value_type;
+	iterator() =default;
+	iterator(const double_array_trie<T>* da) : da{da}, at_end{false} {
+		parents.push({root, da->links[root].first});
+		fall_down();
+	}
+
+	const T& operator*() const { return built; }
+	const T* operator->() const { return &built; }
+
+	iterator& operator++() {
+		if(parents.top().code == in_tail) {
+			built.resize(built.size() - da->tail_length(parents.top().s));
+			parents.pop();
+		}
+		leave_child();
+		fall_down();
+		return *this;
+	}
+	iterator operator++(int) {
+		iterator temp {*this};
+		++*this;
+		return temp;
+	}
+	iterator& operator--() {
+		if(at_end)
+			at_end = false;
+		else if(parents.top().code == in_tail) {
+			built.resize(built.size() - da->tail_length(parents.top().s));
+			parents.pop();
+			built.pop_back();
+		}
+		climb_back();
+		return *this;
+	}
+	iterator operator--(int) {
+		iterator temp {*this};
+		--*this;
+		return temp;
+	}
+
+	bool operator==(const iterator& other) const {
+		return at_end == other.at_end && (at_end || parents.top() == other.parents.top());
+	}
+	bool operator!=(const iterator& other) const { return !operator==(other); }
+private:
+	iterator(const double_array_trie<T>* da, std::stack<state>&& parents, const T& built, bool at_end) :
+		da{da}, parents{std::move(parents)}, built{built}, at_end{at_end} {}
+
+	// Moves on to the next sibling of the top state's child.
+	void leave_child() {
+		state& top = parents.top();
+		if(top.code != 0)
+			built.pop_back();
+		top.code = da->links[da->cells[top.s].base + top.code].next;
+	}
+	// Moves forward from the top state to the first key at or after it.
+	void fall_down() {
+		for(;;) {
+			state& top = parents.top();
+			if(top.code == 0 || top.code == in_tail)
+				return;
+			if(top.code == none) {
+				if(parents.size() == 1) {
+					at_end = true;
+					return;
+				}
+				parents.pop();
+				leave_child();
+				continue;
+			}
+			built.push_back(symbol_of(top.code));
+			int32_t t = da->cells[top.s].base + top.code;
+			if(da->cells[t].base < 0) {
+				const unsigned char* rest = da->tail_symbols(t);
+				for(uint32_t i = 0, n = da->tail_length(t); i < n; ++i)
+					built.push_back(static_cast<symbol>(rest[i]));
+				parents.push({t, in_tail});
+				return;
+			}
+			parents.push({t, da->links[t].first});
+		}
+	}
+	// The code of the sibling before c among s's children, or none.  Only
+	// next links are stored, so this walks the list from the first child;
+	// c == none gives the last child.
+	uint16_t previous_child(int32_t s, uint16_t c) const {
+		uint16_t p = none;
+		for(uint16_t k = da->links[s].first; k != c; k = da->links[da->cells[s].base + k].next)
+			p = k;
+		return p;
+	}
+	// Moves backward from the top state, whose child has already been left,
+	// to the last key before it.
+	void climb_back() {
+		uint16_t p;
+		while((p = previous_child(parents.top().s, parents.top().code)) == none) {
+			parents.pop();
+			built.pop_back();
+		}
+		// Take the last child all the way down.  Code 0 sorts first, so it is
+		// only ever last in a state that has no other children.
+		for(;;) {
+			state& top = parents.top();
+			top.code = p;
+			if(p == 0)
+				return;
+			built.push_back(symbol_of(p));
+			int32_t t = da->cells[top.s].base + p;
+			if(da->cells[t].base < 0) {
+				const unsigned char* rest = da->tail_symbols(t);
+				for(uint32_t i = 0, n = da->tail_length(t); i < n; ++i)
+					built.push_back(static_cast<symbol>(rest[i]));
+				parents.push({t, in_tail});
+				return;
+			}
+			parents.push({t, none});
+			p = previous_child(t, none);
+		}
+	}
+};
+
+template<typename T>
+constexpr uint16_t double_array_trie<T>::iterator::in_tail;
+
+#endif
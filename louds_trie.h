@@ -0,0 +1,255 @@
+// louds_trie.h - A succinct read-only trie
+// Copyright (C) 2013  George Hilliard
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef LOUDS_TRIE_H
+#define LOUDS_TRIE_H
+
+#include <queue>
+#include <stack>
+#include <vector>
+#include <cstdint>
+#include <utility>
+
+#include "trie.h"
+#include "trie_bit_vector.h"
+
+// A read-only copy of a trie<T> in LOUDS form (level-order unary degree
+// sequence): about two bits per node for the shape of the tree, one more to
+// mark which nodes end keys, and the symbols themselves.
+//
+// Nodes are numbered in breadth-first order, the root first.  The shape is
+// "10" followed by each node's degree in unary: a 1 per child, then a 0.  So
+// the list of node x starts just after zero number x, and since x + 1 zeros
+// come before it, its children are numbered from select0(x) - x on.  Each
+// node's symbol is in labels, under its number less one.
+template<typename T>
+class louds_trie {
+	// data members and types
+	typedef typename T::value_type symbol;
+	typedef trie_symbol_search<symbol> search;
+
+	trie_bit_vector tree;
+	trie_bit_vector terminal;  // whether each node ends a key
+	std::vector<symbol> labels;
+	size_t keys = 0;
+
+public:
+	// misc. declarations
+	class iterator;
+	typedef T key_type;
+	typedef T value_type;
+	typedef size_t size_type;
+	typedef iterator const_iterator;
+
+	// constructors
+	louds_trie();
+	template<typename Alloc> explicit louds_trie(const trie<T, Alloc>&);
+
+	// iterators and related
+	iterator begin() const;
+	iterator end() const;
+	const_iterator cbegin() const { return begin(); }
+	const_iterator cend() const { return end(); }
+
+	// other members
+	bool empty() const { return keys == 0; }
+	size_type size() const { return keys; }
+	// Bytes taken by the bit vectors and labels
+	size_type memory_usage() const {
+		return sizeof(*this) + tree.allocated_bytes() + terminal.allocated_bytes() + labels.capacity() * sizeof(symbol);
+	}
+
+	const_iterator find(const key_type&) const;
+	size_type count(const key_type& key) const { return contains(key) ? 1 : 0; }
+	bool contains(const key_type&) const;
+
+	std::pair<const_iterator,const_iterator> equal_prefix_range(const key_type&) const;
+	size_type count_prefix(const key_type&) const;
+
+	void swap(louds_trie& other) {
+		std::swap(tree, other.tree);
+		std::swap(terminal, other.terminal);
+		labels.swap(other.labels);
+		std::swap(keys, other.keys);
+	}
+	static void swap(louds_trie& a, louds_trie& b) { a.swap(b); }
+
+private:
+	// Number of node x's first child
+	size_t first_child(size_t x) const { return tree.select0(x) - x; }
+	// Node x's first child and how many children it has
+	void children(size_t x, size_t& first, uint32_t& n) const {
+		size_t start = tree.select0(x) + 1;
+		first = start - x - 1;
+		n = tree.next_zero(start) - start;
+	}
+	// Index of the child of x (whose children are as given) labeled s, or npos
+	uint32_t find_child(size_t first, uint32_t n, const symbol& s) const {
+		return n == 0 ? search::npos : search::find(labels.data() + first - 1, n, s);
+	}
+
+	bool descend(const key_type&, iterator&, size_t&) const;
+};
+
+// Definition of louds_trie<T>::iterator
+#include "louds_trie_iterator.h"
+
+template<typename T>
+louds_trie<T>::louds_trie()
+{
+	tree.push_back(1);
+	tree.push_back(0);
+	tree.push_back(0);
+	tree.finish();
+	terminal.push_back(0);
+	terminal.finish();
+}
+
+template<typename T>
+template<typename Alloc>
+louds_trie<T>::louds_trie(const trie<T, Alloc>& from) :
+	keys{from.size()}
+{
+	typedef typename trie<T, Alloc>::node node;
+
+	// A nullptr child ends a key, so it becomes a terminal node with no
+	// children.
+	std::queue<const node*> level_order;
+	level_order.push(&from.root);
+	tree.push_back(1);
+	tree.push_back(0);
+	while(!level_order.empty()) {
+		const node* n = level_order.front();
+		level_order.pop();
+		terminal.push_back(n == nullptr || n->is_leaf);
+		if(n != nullptr) {
+			for(auto slot = n->children.first(); slot != n->children.end_slot(); slot = n->children.next(slot)) {
+				tree.push_back(1);
+				labels.push_back(n->children.symbol(slot));
+				level_order.push(n->children.child(slot));
+			}
+		}
+		tree.push_back(0);
+	}
+	tree.finish();
+	terminal.finish();
+
+	// The vectorized search may read up to a vector's width past the last label.
+	labels.resize(labels.size() + 32);
+	labels.shrink_to_fit();
+}
+
+template<typename T>
+auto louds_trie<T>::begin() const -> iterator
+{
+	return {this, 0};
+}
+
+template<typename T>
+auto louds_trie<T>::end() const -> iterator
+{
+	std::stack<typename iterator::state> temp;
+	temp.push(iterator::enter(this, 0));
+	temp.top().index = temp.top().children;
+	return {this, std::move(temp), T{}, true};
+}
+
+template<typename T>
+bool louds_trie<T>::descend(const key_type& key, iterator& it, size_t& x) const
+{
+	// Pushes the path to key onto it, leaving x at the node key ends on.
+	// Returns false if there is no such node.
+	x = 0;
+	for(auto inputIt = key.cbegin(); inputIt != key.cend(); ++inputIt) {
+		auto st = iterator::enter(this, x);
+		st.index = find_child(st.first, st.children, *inputIt);
+		if(st.index == search::npos)
+			return false;
+		it.parents.push(st);
+		x = st.first + st.index;
+	}
+	return true;
+}
+
+template<typename T>
+auto louds_trie<T>::find(const key_type& key) const -> const_iterator
+{
+	iterator it{this, std::stack<typename iterator::state>{}, key, false};
+	size_t x;
+	if(!descend(key, it, x) || !terminal[x])
+		return cend();
+	it.parents.push(iterator::enter(this, x));
+	return it;
+}
+
+template<typename T>
+bool louds_trie<T>::contains(const key_type& key) const
+{
+	size_t x = 0;
+
+	for(auto inputIt = key.cbegin(); inputIt != key.cend(); ++inputIt) {
+		size_t first;
+		uint32_t n;
+		children(x, first, n);
+		uint32_t index = find_child(first, n, *inputIt);
+		if(index == search::npos)
+			return false;
+		x = first + index;
+	}
+	return terminal[x];
+}
+
+template<typename T>
+auto louds_trie<T>::equal_prefix_range(const key_type& prefix) const -> std::pair<const_iterator,const_iterator>
+{
+	if(prefix.empty())
+		return {cbegin(), cend()};
+
+	iterator first{this, std::stack<typename iterator::state>{}, prefix, false};
+	size_t subtree;
+	if(!descend(prefix, first, subtree))
+		return {cend(), cend()};
+
+	iterator last{first};
+	++last;
+	first.parents.push(iterator::enter(this, subtree));
+	first.fall_down();
+	return {std::move(first), std::move(last)};
+}
+
+template<typename T>
+auto louds_trie<T>::count_prefix(const key_type& prefix) const -> size_type
+{
+	size_t x = 0;
+	for(auto inputIt = prefix.cbegin(); inputIt != prefix.cend(); ++inputIt) {
+		size_t first;
+		uint32_t n;
+		children(x, first, n);
+		uint32_t index = find_child(first, n, *inputIt);
+		if(index == search::npos)
+			return 0;
+		x = first + index;
+	}
+
+	// The subtree's nodes on each level are numbered consecutively, and the
+	// children of nodes [a, b) are the nodes [first_child(a), first_child(b)).
+	size_type total = 0;
+	for(size_t a = x, b = x + 1; a < b; a = first_child(a), b = first_child(b))
+		total += terminal.rank1(b) - terminal.rank1(a);
+	return total;
+}
+
+#endif
@@ -0,0 +1,143 @@
+#ifndef LOUDS_TRIE_ITERATOR_H
+#define LOUDS_TRIE_ITERATOR_H
+
+#include <iterator>
+
+#include "louds_trie.h"
+
+template<typename T>
+class louds_trie<T>::iterator : public std::iterator<std::bidirectional_iterator_tag, T> {
+	friend class louds_trie<T>;
+
+	// data members and types
+
+	// Works like trie<T>::iterator.  Each state is a node on the path, where
+	// its children are, and the index of the child being followed out of it,
+	// or npos for the node's own key.  Every key ends on a node, so the top
+	// state is always at npos.
+	static constexpr uint32_t npos = louds_trie<T>::search::npos;
+	struct state {
+		size_t node;
+		size_t first;
+		uint32_t children;
+		uint32_t index;
+
+		bool operator==(const state& other) const {
+			return node == other.node && index == other.index;
+		}
+	};
+
+	const louds_trie<T>* louds;
+	std::stack<state> parents;
+	T built;
+	bool at_end;
+
+public:
+	typedef const T value_type;
+	iterator() =default;
+	iterator(const louds_trie<T>* louds, size_t node) : louds{louds}, at_end{false} {
+		parents.push(enter(louds, node));
+		fall_down();
+	}
+
+	const T& operator*() const { return built; }
+	const T* operator->() const { return &built; }
+
+	iterator& operator++() {
+		if(parents.top().index == npos)
+			parents.top().index = 0;
+		else
+			leave_child();
+		fall_down();
+		return *this;
+	}
+	iterator operator++(int) {
+		iterator temp {*this};
+		++*this;
+		return temp;
+	}
+	iterator& operator--() {
+		if(at_end)
+			at_end = false;
+		else {
+			parents.pop();
+			built.pop_back();
+		}
+		climb_back();
+		return *this;
+	}
+	iterator operator--(int) {
+		iterator temp {*this};
+		--*this;
+		return temp;
+	}
+
+	bool operator==(const iterator& other) const {
+		return at_end == other.at_end && (at_end || parents.top() == other.parents.top());
+	}
+	bool operator!=(const iterator& other) const { return !operator==(other); }
+private:
+	iterator(const louds_trie<T>* louds, std::stack<state>&& parents, const T& built, bool at_end) :
+		louds{louds}, parents{std::move(parents)}, built{built}, at_end{at_end} {}
+
+	// The state for arriving at node x
+	static state enter(const louds_trie<T>* louds, size_t x) {
+		state st;
+		st.node = x;
+		louds->children(x, st.first, st.children);
+		st.index = louds->terminal[x] ? npos : 0;
+		return st;
+	}
+
+	void inline leave_child() {
+		built.pop_back();
+		++parents.top().index;
+	}
+	// Moves forward from the top state to the first key at or after it.
+	void fall_down() {
+		for(;;) {
+			state& top = parents.top();
+			if(top.index == npos)
+				return;
+			if(top.index == top.children) {
+				if(parents.size() == 1) {
+					at_end = true;
+					return;
+				}
+				parents.pop();
+				leave_child();
+				continue;
+			}
+			built.push_back(louds->labels[top.first + top.index - 1]);
+			parents.push(enter(louds, top.first + top.index));
+		}
+	}
+	// Moves backward from the top state, whose child has already been left,
+	// to the last key before it.
+	void climb_back() {
+		while(parents.top().index == 0) {
+			if(louds->terminal[parents.top().node]) {
+				parents.top().index = npos;
+				return;
+			}
+			parents.pop();
+			built.pop_back();
+		}
+		--parents.top().index;
+		for(;;) {
+			const state& top = parents.top();
+			built.push_back(louds->labels[top.first + top.index - 1]);
+			state child = enter(louds, top.first + top.index);
+			// A node with no children always ends a key.
+			child.index = child.children == 0 ? npos : child.children - 1;
+			parents.push(child);
+			if(child.index == npos)
+				return;
+		}
+	}
+};
+
+template<typename T>
+constexpr uint32_t louds_trie<T>::iterator::npos;
+
+#endif
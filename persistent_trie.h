@@ -0,0 +1,314 @@
+// persistent_trie.h - A trie whose copies share their nodes
+// Copyright (C) 2013  George Hilliard
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef PERSISTENT_TRIE_H
+#define PERSISTENT_TRIE_H
+
+#include <stack>
+#include <vector>
+#include <atomic>
+#include <utility>
+#include <iterator>
+#include <cstddef>
+#include <algorithm>
+#include <initializer_list>
+
+// A set of keys like trie<T>, but a copy is O(1): it shares every node with
+// the original.  Nodes are reference counted, and a node that more than one
+// trie can reach is never changed.  insert() and erase() copy just the nodes
+// on the key's path that are shared, and change the rest in place, so each
+// copy acts like a deep copy.
+//
+// The counts are atomic, so copies can be handed to other threads: a
+// snapshot stays valid and readable there while the original goes on
+// changing.  As with any container, a single persistent_trie object must not
+// be changed while another thread uses that same object.
+template<typename T>
+class persistent_trie {
+	// data members and types
+	typedef typename T::value_type symbol;
+
+	struct node {
+		std::atomic<size_t> refs{1};
+		bool is_leaf = false;
+		size_t count = 0;  // keys in this subtree, counting the node's own
+		// Sorted by symbol
+		std::vector<symbol> symbols;
+		std::vector<node*> children;
+
+		node() =default;
+		// A private copy of a shared node; the children become shared too.
+		node(const node& other) :
+			is_leaf{other.is_leaf}, count{other.count}, symbols(other.symbols), children(other.children)
+		{
+			for(node* c: children)
+				c->refs.fetch_add(1, std::memory_order_relaxed);
+		}
+	};
+
+	node* root;
+
+public:
+	// misc. declarations
+	class iterator;
+	typedef T key_type;
+	typedef T value_type;
+	typedef size_t size_type;
+	typedef iterator const_iterator;
+
+	// constructors
+	persistent_trie() : root{new node} {}
+	persistent_trie(const persistent_trie& other) : root{other.root} { root->refs.fetch_add(1, std::memory_order_relaxed); }
+	persistent_trie(persistent_trie&& other) : persistent_trie() { swap(other); }
+	template<typename InputIt> persistent_trie(InputIt first, InputIt last) : persistent_trie() { insert(first, last); }
+	persistent_trie(std::initializer_list<T> init) : persistent_trie(init.begin(), init.end()) {}
+
+	~persistent_trie() { release(root); }
+
+	// operators
+	persistent_trie& operator=(persistent_trie other) {
+		swap(other);
+		return *this;
+	}
+
+	// iterators and related
+	iterator begin() const;
+	iterator end() const;
+	const_iterator cbegin() const { return begin(); }
+	const_iterator cend() const { return end(); }
+
+	// other members
+	// Returns whether the key was new.
+	bool insert(const key_type&);
+	template<typename InputIt> void insert(InputIt first, InputIt last) {
+		for(; first != last; ++first)
+			insert(*first);
+	}
+	size_type erase(const key_type&);
+	void clear() { persistent_trie().swap(*this); }
+
+	bool empty() const { return root->count == 0; }
+	size_type size() const { return root->count; }
+
+	const_iterator find(const key_type&) const;
+	size_type count(const key_type& key) const { return contains(key) ? 1 : 0; }
+	bool contains(const key_type&) const;
+
+	void swap(persistent_trie& other) { std::swap(root, other.root); }
+	static void swap(persistent_trie& a, persistent_trie& b) { a.swap(b); }
+
+private:
+	static void release(node*);
+	// Makes n safe to change: if another trie can reach it, it is replaced
+	// by a private copy.
+	static node* own(node*& n);
+	static node* new_chain(typename T::const_iterator, typename T::const_iterator);
+	void adjust_counts(const key_type&, const node*, std::ptrdiff_t);
+	// Index of s among n's children, or the number of children
+	static size_t find_child(const node* n, const symbol& s) {
+		size_t i = std::lower_bound(n->symbols.begin(), n->symbols.end(), s) - n->symbols.begin();
+		return (i != n->symbols.size() && n->symbols[i] == s) ? i : n->symbols.size();
+	}
+};
+
+// Definition of persistent_trie<T>::iterator
+#include "persistent_trie_iterator.h"
+
+template<typename T>
+void persistent_trie<T>::release(node* n)
+{
+	// The last trie to let go of a node deletes it, and lets go of its children.
+	if(n->refs.fetch_sub(1, std::memory_order_acq_rel) != 1)
+		return;
+	for(node* c: n->children)
+		release(c);
+	delete n;
+}
+
+template<typename T>
+auto persistent_trie<T>::own(node*& n) -> node*
+{
+	// The count can only be 1 if every trie but this one has let go, and
+	// then none of them can take it up again.
+	if(n->refs.load(std::memory_order_acquire) != 1) {
+		node* copy = new node(*n);
+		release(n);
+		n = copy;
+	}
+	return n;
+}
+
+template<typename T>
+auto persistent_trie<T>::new_chain(typename T::const_iterator first, typename T::const_iterator last) -> node*
+{
+	// A node holding one key: the symbols of [first, last) down to a leaf.
+	node* top = new node;
+	node* n = top;
+	try {
+		for(; first != last; ++first) {
+			n->count = 1;
+			n->symbols.push_back(*first);
+			n->children.push_back(nullptr);
+			n = n->children.back() = new node;
+		}
+	}
+	catch(...) {
+		// Drop the unused slot, if any, before letting go of the chain.
+		if(!n->children.empty() && n->children.back() == nullptr) {
+			n->children.pop_back();
+			n->symbols.pop_back();
+		}
+		release(top);
+		throw;
+	}
+	n->count = 1;
+	n->is_leaf = true;
+	return top;
+}
+
+template<typename T>
+void persistent_trie<T>::adjust_counts(const key_type& key, const node* last, std::ptrdiff_t delta)
+{
+	// Adds delta to the count of every node from the root down to last, on
+	// the path of key.  These nodes are all ours by now.
+	node* n = root;
+	for(auto inputIt = key.cbegin(); ; ++inputIt) {
+		n->count += delta;
+		if(n == last)
+			return;
+		n = n->children[find_child(n, *inputIt)];
+	}
+}
+
+template<typename T>
+bool persistent_trie<T>::insert(const key_type& key)
+{
+	// Look first, so a key that is already there copies nothing.
+	if(contains(key))
+		return false;
+
+	// Take over the shared nodes along the part of the key that exists...
+	node* n = own(root);
+	auto inputIt = key.cbegin();
+	for(; inputIt != key.cend(); ++inputIt) {
+		size_t i = find_child(n, *inputIt);
+		if(i == n->symbols.size())
+			break;
+		n = own(n->children[i]);
+	}
+	// ...and hang new nodes for the rest below the last of them.
+	if(inputIt != key.cend()) {
+		node* chain = new_chain(std::next(inputIt), key.cend());
+		size_t i = std::lower_bound(n->symbols.begin(), n->symbols.end(), *inputIt) - n->symbols.begin();
+		try {
+			n->children.insert(n->children.begin() + i, chain);
+			try {
+				n->symbols.insert(n->symbols.begin() + i, *inputIt);
+			}
+			catch(...) {
+				n->children.erase(n->children.begin() + i);
+				throw;
+			}
+		}
+		catch(...) {
+			release(chain);
+			throw;
+		}
+	}
+	else
+		n->is_leaf = true;
+
+	adjust_counts(key, n, 1);
+	return true;
+}
+
+template<typename T>
+auto persistent_trie<T>::erase(const key_type& key) -> size_type
+{
+	if(!contains(key))
+		return 0;
+
+	// Take over the shared nodes down to where the key's branch can be cut off...
+	node* n = own(root);
+	auto inputIt = key.cbegin();
+	for(; inputIt != key.cend(); ++inputIt) {
+		node*& child = n->children[find_child(n, *inputIt)];
+		if(child->count == 1)
+			// Nothing but this key down there
+			break;
+		n = own(child);
+	}
+
+	// ...and nothing can fail from here on.
+	adjust_counts(key, n, -1);
+	if(inputIt != key.cend()) {
+		size_t i = find_child(n, *inputIt);
+		release(n->children[i]);
+		n->children.erase(n->children.begin() + i);
+		n->symbols.erase(n->symbols.begin() + i);
+	}
+	else
+		n->is_leaf = false;
+	return 1;
+}
+
+template<typename T>
+bool persistent_trie<T>::contains(const key_type& key) const
+{
+	const node* n = root;
+	for(auto inputIt = key.cbegin(); inputIt != key.cend(); ++inputIt) {
+		size_t i = find_child(n, *inputIt);
+		if(i == n->symbols.size())
+			return false;
+		n = n->children[i];
+	}
+	return n->is_leaf;
+}
+
+template<typename T>
+auto persistent_trie<T>::begin() const -> iterator
+{
+	return {root};
+}
+
+template<typename T>
+auto persistent_trie<T>::end() const -> iterator
+{
+	std::stack<typename iterator::state> temp;
+	temp.push({root, root->children.size()});
+	return {std::move(temp), T{}, true};
+}
+
+template<typename T>
+auto persistent_trie<T>::find(const key_type& key) const -> const_iterator
+{
+	iterator it{std::stack<typename iterator::state>{}, key, false};
+	const node* n = root;
+
+	for(auto inputIt = key.cbegin(); inputIt != key.cend(); ++inputIt) {
+		size_t i = find_child(n, *inputIt);
+		if(i == n->symbols.size())
+			return cend();
+		it.parents.push({n, i});
+		n = n->children[i];
+	}
+	if(!n->is_leaf)
+		return cend();
+	it.parents.push({n, iterator::npos});
+	return it;
+}
+
+#endif
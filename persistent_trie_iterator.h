@@ -0,0 +1,133 @@
+#ifndef PERSISTENT_TRIE_ITERATOR_H
+#define PERSISTENT_TRIE_ITERATOR_H
+
+#include <iterator>
+
+#include "persistent_trie.h"
+
+template<typename T>
+class persistent_trie<T>::iterator : public std::iterator<std::bidirectional_iterator_tag, T> {
+	friend class persistent_trie<T>;
+
+	// data members and types
+
+	// Works like trie<T>::iterator.  Each state is a node on the path and the
+	// index of the child being followed out of it, or npos for the node's own
+	// key.  Every key ends on a node, so the top state is always at npos.
+	// An iterator stays valid as long as its trie isn't changed; copies of
+	// the trie may change freely.
+	static constexpr size_t npos = static_cast<size_t>(-1);
+	struct state {
+		const typename persistent_trie<T>::node* node;
+		size_t index;
+
+		bool operator==(const state& other) const {
+			return node == other.node && index == other.index;
+		}
+	};
+
+	std::stack<state> parents;
+	T built;
+	bool at_end;
+
+public:
+	typedef const T value_type;
+	iterator() =default;
+	iterator(const typename persistent_trie<T>::node* root) : at_end{false} {
+		parents.push({root, root->is_leaf ? npos : 0});
+		fall_down();
+	}
+
+	const T& operator*() const { return built; }
+	const T* operator->() const { return &built; }
+
+	iterator& operator++() {
+		if(parents.top().index == npos)
+			parents.top().index = 0;
+		else
+			leave_child();
+		fall_down();
+		return *this;
+	}
+	iterator operator++(int) {
+		iterator temp {*this};
+		++*this;
+		return temp;
+	}
+	iterator& operator--() {
+		if(at_end)
+			at_end = false;
+		else {
+			parents.pop();
+			built.pop_back();
+		}
+		climb_back();
+		return *this;
+	}
+	iterator operator--(int) {
+		iterator temp {*this};
+		--*this;
+		return temp;
+	}
+
+	bool operator==(const iterator& other) const {
+		return at_end == other.at_end && (at_end || parents.top() == other.parents.top());
+	}
+	bool operator!=(const iterator& other) const { return !operator==(other); }
+private:
+	iterator(std::stack<state>&& parents, const T& built, bool at_end) :
+		parents{std::move(parents)}, built{built}, at_end{at_end} {}
+
+	void inline leave_child() {
+		built.pop_back();
+		++parents.top().index;
+	}
+	// Moves forward from the top state to the first key at or after it.
+	void fall_down() {
+		for(;;) {
+			state& top = parents.top();
+			if(top.index == npos)
+				return;
+			if(top.index == top.node->children.size()) {
+				if(parents.size() == 1) {
+					at_end = true;
+					return;
+				}
+				parents.pop();
+				leave_child();
+				continue;
+			}
+			built.push_back(top.node->symbols[top.index]);
+			const typename persistent_trie<T>::node* child = top.node->children[top.index];
+			parents.push({child, child->is_leaf ? npos : 0});
+		}
+	}
+	// Moves backward from the top state, whose child has already been left,
+	// to the last key before it.
+	void climb_back() {
+		while(parents.top().index == 0) {
+			if(parents.top().node->is_leaf) {
+				parents.top().index = npos;
+				return;
+			}
+			parents.pop();
+			built.pop_back();
+		}
+		--parents.top().index;
+		for(;;) {
+			const state& top = parents.top();
+			built.push_back(top.node->symbols[top.index]);
+			const typename persistent_trie<T>::node* child = top.node->children[top.index];
+			// A node with no children always ends a key.
+			size_t children = child->children.size();
+			parents.push({child, children == 0 ? npos : children - 1});
+			if(children == 0)
+				return;
+		}
+	}
+};
+
+template<typename T>
+constexpr size_t persistent_trie<T>::iterator::npos;
+
+#endif
@@ -0,0 +1,476 @@
+// radix_trie.h - A path-compressed (PATRICIA) variant of trie<T>
+// Copyright (C) 2013  George Hilliard
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef RADIX_TRIE_H
+#define RADIX_TRIE_H
+
+#include <stack>
+#include <vector>
+#include <memory>
+#include <iterator>
+#include <utility>
+#include <algorithm>
+#include <limits>
+#include <initializer_list>
+
+// radix_trie<T> has the same interface as trie<T>, but every edge is labeled
+// with a nonempty fragment of a key instead of a single symbol.  Chains of
+// nodes that have one child and hold no key are collapsed into one edge, so a
+// long key with a unique suffix costs a single node instead of one per symbol.
+//
+// The node invariants are the same as trie<T>'s, plus one:
+//  - A child that is nullptr terminates a key and has no children.
+//  - Children are sorted by the first symbol of their edge label, and no two
+//    labels out of the same node share a first symbol.
+//  - Any node other than the root either holds a key (is_leaf) or has at
+//    least two children.
+template<typename T>
+class radix_trie {
+	// data members and types
+	typedef std::vector<std::pair<T, std::unique_ptr<radix_trie<T>>>> child_map_type;
+	child_map_type children;
+	bool is_leaf = false;
+
+public:
+	// misc. declarations
+	class iterator;
+	typedef T key_type;
+	typedef T value_type;
+	typedef size_t size_type;
+	typedef iterator const_iterator;
+
+	// constructors
+	radix_trie(bool = false);
+	radix_trie(const radix_trie<T>&);
+	radix_trie(radix_trie<T>&&);
+	template<typename InputIt> radix_trie(InputIt, InputIt, bool = false);
+	radix_trie(std::initializer_list<T>);
+
+	// destructor, auto-generated one is fine
+	~radix_trie() =default;
+
+	// operators
+	radix_trie<T>& operator=(radix_trie<T>);
+
+	// iterators and related
+	iterator begin() const;
+	iterator end() const;
+	const_iterator cbegin() const { return begin(); }
+	const_iterator cend() const { return end(); }
+
+	// other members
+	std::pair<iterator,bool> insert(const value_type&);
+	template<typename InputIt> void insert(InputIt, const InputIt&);
+
+	iterator erase(const_iterator);
+	size_type erase(const key_type&);
+	iterator erase(const_iterator, const_iterator);
+	void clear();
+
+	bool empty() const { return children.empty() && !is_leaf; }
+	size_type size() const;
+	constexpr size_type max_size() const;
+
+	const_iterator find(const key_type&) const;
+	size_type count(const key_type&) const;
+	bool contains(const key_type&) const;
+
+	void swap(radix_trie<T>&);
+	static void swap(radix_trie<T>& a, radix_trie<T>& b) { a.swap(b); }
+
+private:
+	bool insert_key(const value_type&, iterator* = nullptr);
+	static void prune(typename child_map_type::value_type&);
+	typename child_map_type::iterator child_for(const typename T::value_type&);
+	typename child_map_type::const_iterator child_for(const typename T::value_type&) const;
+};
+
+// Definition of radix_trie<T>::iterator
+#include "radix_trie_iterator.h"
+
+template<typename T>
+radix_trie<T>::radix_trie(bool is_leaf) :
+	is_leaf{is_leaf}
+{}
+
+template<typename T>
+radix_trie<T>::radix_trie(const radix_trie<T>& other) :
+	is_leaf{other.is_leaf}
+{
+	// Deep copy the children
+	children.reserve(other.children.size());
+	for(const auto& it : other.children) {
+		// Separate creation of unique_ptr for exception safety
+		std::unique_ptr<radix_trie<T>> p(it.second == nullptr ? nullptr : new radix_trie<T>(*it.second));
+		children.emplace(children.end(), it.first, std::move(p));
+	}
+}
+
+template<typename T>
+radix_trie<T>::radix_trie(radix_trie<T>&& other) :
+	children{std::move(other.children)}, is_leaf{other.is_leaf}
+{}
+
+template<typename T>
+template<typename InputIt>
+radix_trie<T>::radix_trie(const InputIt begin, const InputIt end, bool is_leaf) :
+	is_leaf{is_leaf}
+{
+	insert(begin, end);
+}
+
+template<typename T>
+radix_trie<T>::radix_trie(std::initializer_list<T> l) :
+	is_leaf{false}
+{
+	insert(l.begin(), l.end());
+}
+
+template<typename T>
+radix_trie<T>& radix_trie<T>::operator=(radix_trie<T> other)
+{
+	swap(*this, other);
+	return *this;
+}
+
+template<typename T>
+auto radix_trie<T>::begin() const -> iterator
+{
+	return {this};
+}
+
+template<typename T>
+auto radix_trie<T>::end() const -> iterator
+{
+	std::stack<typename iterator::state> temp;
+	temp.push({this, this->children.size()});
+	return {std::move(temp), T{}, true};
+}
+
+template<typename T>
+auto radix_trie<T>::child_for(const typename T::value_type& symbol) -> typename child_map_type::iterator
+{
+	// Labels never share a first symbol, so this finds the only candidate edge.
+	auto childIt = std::lower_bound(children.begin(), children.end(), symbol,
+	                                [](const std::pair<T,std::unique_ptr<radix_trie<T>>>& x, const typename T::value_type& y)
+	                                  { return x.first.front() < y; });
+	return childIt;
+}
+
+template<typename T>
+auto radix_trie<T>::child_for(const typename T::value_type& symbol) const -> typename child_map_type::const_iterator
+{
+	return const_cast<radix_trie<T>*>(this)->child_for(symbol);
+}
+
+// If it is given, its stack is filled in with the path to value's position,
+// so insert() doesn't have to look the key up again.
+template<typename T>
+bool radix_trie<T>::insert_key(const value_type& value, iterator* it)
+{
+	radix_trie<T>* currentNode = this;
+	auto inputIt = value.cbegin();
+	auto push = [it](const radix_trie<T>* node, size_type index) {
+		if(it != nullptr)
+			it->parents.push({node, index});
+	};
+
+	for(;;) {
+		if(inputIt == value.cend()) {
+			// The key ends exactly on a node.
+			bool inserted = !currentNode->is_leaf;
+			currentNode->is_leaf = true;
+			push(currentNode, iterator::npos);
+			return inserted;
+		}
+
+		auto childIt = currentNode->child_for(*inputIt);
+		const size_type index = childIt - currentNode->children.begin();
+		if(childIt == currentNode->children.end() || childIt->first.front() != *inputIt) {
+			// No edge starts with this symbol; the whole remainder becomes one new edge.
+			currentNode->children.emplace(childIt, T(inputIt, value.cend()), nullptr);
+			push(currentNode, index);
+			return true;
+		}
+		push(currentNode, index);
+
+		T& label = childIt->first;
+		auto labelIt = label.begin();
+		while(labelIt != label.end() && inputIt != value.cend() && *labelIt == *inputIt) {
+			++labelIt;
+			++inputIt;
+		}
+
+		if(labelIt == label.end()) {
+			// The whole label matched.
+			if(childIt->second != nullptr) {
+				currentNode = childIt->second.get();
+				continue;
+			}
+			if(inputIt == value.cend())
+				// The key is already present as a terminal edge.
+				return false;
+			// Grow the terminal into a node that keeps its key.
+			std::unique_ptr<radix_trie<T>> node(new radix_trie<T>{true});
+			node->children.emplace(node->children.end(), T(inputIt, value.cend()), nullptr);
+			push(node.get(), 0);
+			childIt->second = std::move(node);
+			return true;
+		}
+
+		// The key diverges partway along the label, so split the edge.
+		std::unique_ptr<radix_trie<T>> split(new radix_trie<T>{inputIt == value.cend()});
+		split->children.emplace(split->children.end(), T(labelIt, label.end()), std::move(childIt->second));
+		if(inputIt != value.cend()) {
+			auto pos = split->children.begin();
+			if(split->children.front().first.front() < *inputIt)
+				++pos;
+			push(split.get(), pos - split->children.begin());
+			split->children.emplace(pos, T(inputIt, value.cend()), nullptr);
+		}
+		else
+			push(split.get(), iterator::npos);
+		label.erase(labelIt, label.end());
+		childIt->second = std::move(split);
+		return true;
+	}
+}
+
+template<typename T>
+auto radix_trie<T>::insert(const value_type& value) -> std::pair<iterator,bool>
+{
+	iterator it{std::stack<typename iterator::state>{}, value, false};
+	bool inserted = insert_key(value, &it);
+	return {std::move(it), inserted};
+}
+
+template<typename T>
+template<typename InputIt>
+void radix_trie<T>::insert(InputIt start, const InputIt& finish)
+{
+	// Nobody looks at the iterators, so don't build them.
+	while(start != finish)
+		insert_key(*(start++));
+}
+
+template<typename T>
+auto radix_trie<T>::erase(const_iterator it) -> iterator
+{
+	// Erase through the iterator's own stack, then leave the stack positioned
+	// so that fall_down() lands on the next key.
+	auto& top = it.parents.top();
+	radix_trie<T>* node = const_cast<radix_trie<T>*>(top.node);
+	if(top.index == iterator::npos) {
+		node->is_leaf = false;
+		top.index = 0;
+	}
+	else {
+		it.drop_label();
+		node->children.erase(node->children.begin() + top.index);
+	}
+
+	if(node != this) {
+		// Only the last node on the path can have become redundant.
+		const bool past = top.index == node->children.size();
+		const bool collapses = !node->is_leaf && node->children.size() == 1;
+		const bool empties = node->is_leaf && node->children.empty();
+		if(collapses || empties) {
+			it.parents.pop();
+			auto& parent = it.parents.top();
+			auto& edge = const_cast<radix_trie<T>*>(parent.node)->children[parent.index];
+			it.drop_label();
+			prune(edge);
+			if(past || empties)
+				++parent.index;
+		}
+	}
+
+	it.fall_down();
+	return it;
+}
+
+template<typename T>
+auto radix_trie<T>::erase(const key_type& key) -> size_type
+{
+	// Removing a key can only make the last node on its path redundant,
+	// so remember that node and the edge leading to it.
+	radix_trie<T>* currentNode = this;
+	typename child_map_type::iterator currentEdge;
+	auto inputIt = key.cbegin();
+
+	for(;;) {
+		if(inputIt == key.cend()) {
+			if(!currentNode->is_leaf)
+				return 0;
+			currentNode->is_leaf = false;
+			break;
+		}
+
+		auto childIt = currentNode->child_for(*inputIt);
+		if(childIt == currentNode->children.end() || childIt->first.front() != *inputIt)
+			return 0;
+		const T& label = childIt->first;
+		if(static_cast<size_type>(std::distance(inputIt, key.cend())) < label.size() ||
+		   !std::equal(label.begin(), label.end(), inputIt))
+			return 0;
+		inputIt += label.size();
+
+		if(childIt->second == nullptr) {
+			if(inputIt != key.cend())
+				return 0;
+			// Drop the terminal edge; currentNode may now be redundant.
+			currentNode->children.erase(childIt);
+			break;
+		}
+
+		currentNode = childIt->second.get();
+		currentEdge = childIt;
+	}
+
+	if(currentNode != this)
+		prune(*currentEdge);
+	return 1;
+}
+
+// Restores the invariants for the node at the end of edge after one of its
+// keys has been erased.
+template<typename T>
+void radix_trie<T>::prune(typename child_map_type::value_type& edge)
+{
+	radix_trie<T>* node = edge.second.get();
+	if(!node->is_leaf && node->children.size() == 1) {
+		// Collapse the single remaining child into the edge above it.
+		auto& only = node->children.front();
+		edge.first.insert(edge.first.end(), only.first.begin(), only.first.end());
+		std::unique_ptr<radix_trie<T>> grandchild(std::move(only.second));
+		edge.second = std::move(grandchild);
+	}
+	else if(node->is_leaf && node->children.empty())
+		// A key with no children is represented by a nullptr child.
+		edge.second.reset(nullptr);
+}
+
+template<typename T>
+auto radix_trie<T>::erase(const_iterator first, const_iterator last) -> iterator
+{
+	// Erasing can merge edges, which leaves last pointing at stale nodes,
+	// so stop at its key instead.  Each step erases in place through first.
+	if(last.at_end) {
+		while(!first.at_end)
+			first = erase(first);
+		return end();
+	}
+	const key_type stop = *last;
+	while(*first != stop)
+		first = erase(first);
+	return first;
+}
+
+template<typename T>
+void radix_trie<T>::clear()
+{
+	is_leaf = false;
+	children.clear();
+}
+
+template<typename T>
+auto radix_trie<T>::size() const -> size_type
+{
+	size_type s = is_leaf ? 1 : 0;
+	for(const auto& child : children)
+		if(child.second != nullptr)
+			s += child.second->size();
+		else
+			++s;
+	return s;
+}
+
+template<typename T>
+auto radix_trie<T>::find(const key_type& key) const -> const_iterator
+{
+	iterator it{std::stack<typename iterator::state>{}, key, false};
+	decltype(this) currentNode{this};
+	auto inputIt = key.cbegin();
+
+	for(;;) {
+		if(inputIt == key.cend()) {
+			if(!currentNode->is_leaf)
+				return cend();
+			it.parents.push({currentNode, iterator::npos});
+			return it;
+		}
+
+		auto childIt = currentNode->child_for(*inputIt);
+		if(childIt == currentNode->children.end() || childIt->first.front() != *inputIt)
+			return cend();
+		const T& label = childIt->first;
+		if(static_cast<size_type>(std::distance(inputIt, key.cend())) < label.size() ||
+		   !std::equal(label.begin(), label.end(), inputIt))
+			return cend();
+		inputIt += label.size();
+
+		it.parents.push({currentNode, static_cast<size_type>(childIt - currentNode->children.begin())});
+		if(childIt->second == nullptr)
+			return inputIt == key.cend() ? it : cend();
+		currentNode = childIt->second.get();
+	}
+}
+
+template<typename T>
+auto radix_trie<T>::count(const key_type& key) const -> size_type
+{
+	return contains(key) ? 1 : 0;
+}
+
+template<typename T>
+bool radix_trie<T>::contains(const key_type& key) const
+{
+	decltype(this) currentNode{this};
+	auto inputIt = key.cbegin();
+
+	for(;;) {
+		if(inputIt == key.cend())
+			return currentNode->is_leaf;
+
+		auto childIt = currentNode->child_for(*inputIt);
+		if(childIt == currentNode->children.end() || childIt->first.front() != *inputIt)
+			return false;
+		const T& label = childIt->first;
+		if(static_cast<size_type>(std::distance(inputIt, key.cend())) < label.size() ||
+		   !std::equal(label.begin(), label.end(), inputIt))
+			return false;
+		inputIt += label.size();
+
+		if(childIt->second == nullptr)
+			return inputIt == key.cend();
+		currentNode = childIt->second.get();
+	}
+}
+
+template<typename T>
+constexpr auto radix_trie<T>::max_size() const -> size_type
+{
+	return std::numeric_limits< size_type >::max();
+}
+
+template<typename T>
+void radix_trie<T>::swap(radix_trie<T>& other)
+{
+	std::swap(children, other.children);
+	std::swap(is_leaf, other.is_leaf);
+}
+
+#endif
@@ -0,0 +1,161 @@
+#ifndef RADIX_TRIE_ITERATOR_H
+#define RADIX_TRIE_ITERATOR_H
+
+#include <iterator>
+
+#include "radix_trie.h"
+
+template<typename T>
+class radix_trie<T>::iterator : public std::iterator<std::bidirectional_iterator_tag, T> {
+	friend class radix_trie<T>;
+
+	// data members and types
+
+	// Each state is a node on the path and the index of the edge being followed
+	// out of it.  The top state is either at a terminal (nullptr) edge, or at npos
+	// to mean the node's own key.  built holds the labels of every edge followed.
+	static constexpr size_type npos = std::numeric_limits<size_type>::max();
+	struct state {
+		const radix_trie<T>* node;
+		size_type index;
+
+		bool operator==(const state& other) const {
+			return node == other.node && index == other.index;
+		}
+	};
+
+	std::stack<state> parents;
+	T built;
+	bool at_end;
+
+public:
+	typedef const T value_type;
+	iterator() =default;
+	iterator(const radix_trie<T>* node) : at_end{false} {
+		built.reserve(16);  // Speed up walking around
+		parents.push({node, node->is_leaf ? npos : 0});
+		if(!node->is_leaf)
+			fall_down();
+	}
+	~iterator() =default;
+	iterator(const typename radix_trie<T>::iterator& other) =default;
+	iterator(typename radix_trie<T>::iterator&& other) :
+		parents{std::move(other.parents)},
+		built{std::move(other.built)},
+		at_end{other.at_end}
+	{}
+	iterator& operator=(typename radix_trie<T>::iterator other) {
+		swap(*this, other);
+		return *this;
+	}
+
+	void swap(typename radix_trie<T>::iterator& other) {
+		std::swap(parents, other.parents);
+		std::swap(built, other.built);
+		std::swap(at_end, other.at_end);
+	}
+	static void swap(typename radix_trie<T>::iterator& a, typename radix_trie<T>::iterator& b) { a.swap(b); }
+
+	const T& operator*() const { return built; }
+	const T* operator->() const { return &built; }
+
+	radix_trie<T>::iterator& operator++() {
+		if(parents.top().index == npos)
+			parents.top().index = 0;
+		else
+			leave_edge();
+		fall_down();
+		return *this;
+	}
+	radix_trie<T>::iterator operator++(int) {
+		iterator temp {*this};
+		++*this;
+		return temp;
+	}
+	radix_trie<T>::iterator& operator--() {
+		if(at_end)
+			at_end = false;
+		else if(parents.top().index == npos) {
+			// Everything under this node sorts after it, so back out of it.
+			parents.pop();
+			drop_label();
+		}
+		else
+			drop_label();
+		climb_back();
+		return *this;
+	}
+	radix_trie<T>::iterator operator--(int) {
+		iterator temp {*this};
+		--*this;
+		return temp;
+	}
+
+	bool operator==(const typename radix_trie<T>::iterator& other) const {
+		return at_end == other.at_end && (at_end || parents.top() == other.parents.top());
+	}
+	bool operator!=(const typename radix_trie<T>::iterator& other) const { return !operator==(other); }
+private:
+	iterator(std::stack<state>&& parents, const T& built, bool at_end) :
+		parents{std::move(parents)}, built{built}, at_end{at_end} {}
+
+	const std::pair<T, std::unique_ptr<radix_trie<T>>>& edge() const {
+		return parents.top().node->children[parents.top().index];
+	}
+	void drop_label() {
+		built.erase(built.end() - edge().first.size(), built.end());
+	}
+	void leave_edge() {
+		drop_label();
+		++parents.top().index;
+	}
+	// Moves forward from the top state to the first key at or after it.
+	void fall_down() {
+		for(;;) {
+			state& top = parents.top();
+			if(top.index == npos)
+				return;
+			if(top.index == top.node->children.size()) {
+				if(parents.size() == 1) {
+					at_end = true;
+					return;
+				}
+				parents.pop();
+				leave_edge();
+				continue;
+			}
+			const auto& e = edge();
+			built.insert(built.end(), e.first.begin(), e.first.end());
+			if(e.second == nullptr)
+				return;
+			parents.push({e.second.get(), e.second->is_leaf ? npos : 0});
+		}
+	}
+	// Moves backward from the top state, whose edge has already been left,
+	// to the last key before it.
+	void climb_back() {
+		while(parents.top().index == 0) {
+			if(parents.top().node->is_leaf) {
+				parents.top().index = npos;
+				return;
+			}
+			parents.pop();
+			drop_label();
+		}
+		--parents.top().index;
+		// Take the last edge all the way down.  Every node below the root has
+		// at least one child, so this ends on a terminal edge.
+		for(;;) {
+			const auto& e = edge();
+			built.insert(built.end(), e.first.begin(), e.first.end());
+			if(e.second == nullptr)
+				return;
+			parents.push({e.second.get(), e.second->children.size() - 1});
+		}
+	}
+};
+
+template<typename T>
+constexpr typename radix_trie<T>::size_type radix_trie<T>::iterator::npos;
+
+#endif
@@ -0,0 +1,128 @@
+#include <iostream>
+#include <string>
+#include <sstream>
+#include <vector>
+#include <cassert>
+#include <cstring>
+#include <cstdint>
+
+#include "trie.h"
+#include "dawg.h"
+#include "trie_view.h"
+#include "radix_trie.h"
+#include "double_array_trie.h"
+
+using namespace std;
+
+// Regression tests for bugs that the benchmark wouldn't catch.  Each one
+// asserts; "make check" runs them all.
+
+/** A copy sizes child arrays exactly; growing one must not leave the sorted layout too early. */
+void copyThenGrowChildren()
+{
+	// Nine children at the root, so the copy's array has capacity nine.
+	trie<string> t;
+	for(char c = 'A'; c < 'A' + 9; ++c)
+		t.insert(string(1, c) + "x");
+
+	trie<string> copy(t);
+	for(char c = 'A' + 9; c < 'A' + 60; ++c)
+		copy.insert(string(1, c) + "x");
+	assert(copy.size() == 60);
+	for(char c = 'A'; c < 'A' + 60; ++c)
+		assert(copy.contains(string(1, c) + "x"));
+}
+
+/** Keys ending on one shared state of a DAWG are still different positions. */
+void dawgSharedSuffixIterators()
+{
+	trie<string> t{"ab", "b", "cab", "cb"};
+	dawg<string> d = t.minimize();
+
+	auto first = d.begin();
+	auto second = first;
+	++second;
+	assert(first != second);
+	assert(d.find("ab") == first);
+	assert(d.find("b") == second);
+
+	// Walking back from end() must stop at begin(), not at the first key
+	// that shares its state.
+	vector<string> backward;
+	for(auto it = d.end(); it != d.begin(); )
+		backward.push_back(*--it);
+	assert((backward == vector<string>{"cb", "cab", "b", "ab"}));
+}
+
+/** Images read the same in every build, and a moved-from view is empty. */
+void imageViewLayoutAndMove()
+{
+	// The padding can't depend on which vectorized search was compiled in.
+	assert(trie_image_layout<char>::padded(3) == 8);
+	assert(trie_image_layout<char>::padded(17) == 32);
+	assert(trie_image_layout<int>::padded(17) == 17);
+
+	// A root with more than 16 children
+	trie<string> t;
+	for(char c = 'A'; c < 'A' + 40; ++c)
+		t.insert(string(1, c) + "x");
+	ostringstream out;
+	t.write_image(out);
+	string bytes = out.str();
+	vector<uint64_t> aligned((bytes.size() + 7) / 8);
+	memcpy(aligned.data(), bytes.data(), bytes.size());
+
+	trie_view<string> view(aligned.data(), bytes.size());
+	assert(view.size() == 40 && view.contains("Zx"));
+	trie_view<string> moved(std::move(view));
+	assert(moved.size() == 40);
+	assert(view.size() == 0 && view.empty());
+	assert(view.begin() == view.end() && !view.contains("Zx"));
+}
+
+/** Iterators returned by radix_trie's insert and erase stay valid across edge splits and merges. */
+void radixTrieInsertEraseIterators()
+{
+	radix_trie<string> t{"abc", "abd", "x"};
+
+	// Splits "ab" into "a" + "b"; the returned iterator is on the new key.
+	auto ins = t.insert("ae");
+	assert(ins.second && *ins.first == "ae");
+	assert(*++ins.first == "x");
+	assert(!t.insert("abc").second);
+
+	// Erasing "abd" merges "ab" + "c" into one edge; the successor is "ae".
+	auto it = t.erase(t.find("abd"));
+	assert(it != t.end() && *it == "ae" && *--it == "abc");
+	assert(*t.erase(t.find("abc")) == "ae");
+	assert(t.erase(t.begin(), t.end()) == t.end() && t.empty());
+}
+
+/** A double_array_trie iterator walks back from end() through tails, own keys and wide states. */
+void doubleArrayBackward()
+{
+	trie<string> t{"", "a", "ab", "abcdef", "b"};
+	for(char c = 'A'; c < 'A' + 40; ++c)
+		t.insert(string("c") + c);
+	double_array_trie<string> d = t.freeze();
+
+	vector<string> forward(d.begin(), d.end());
+	vector<string> backward;
+	for(auto it = d.end(); it != d.begin(); )
+		backward.push_back(*--it);
+	assert(forward.size() == 45);
+	assert((vector<string>(backward.rbegin(), backward.rend()) == forward));
+
+	auto it = d.find("abcdef");
+	assert(*--it == "ab" && *--it == "a" && *--it == "" && it == d.begin());
+}
+
+int main()
+{
+	copyThenGrowChildren();
+	dawgSharedSuffixIterators();
+	imageViewLayoutAndMove();
+	radixTrieInsertEraseIterators();
+	doubleArrayBackward();
+	cout << "OK" << endl;
+}
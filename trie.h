@@ -18,7 +18,7 @@
 #define TRIE_H
 
 #include <map>
-#include <stack>
+#include <vector>
 #include <memory>
 #include <iterator>
 #include <utility>
@@ -26,247 +26,870 @@
 #include <stdexcept>
 #include <limits>
 #include <initializer_list>
+#include <type_traits>
+#include <cstdint>
+#include <cstddef>
+#include <thread>
+#include <atomic>
+#include <exception>
+#include <mutex>
 
-template<typename T>
+#include "trie_allocator.h"
+#include "trie_children.h"
+#include "trie_image.h"
+
+// The value stored with each key of a trie_map, constructed in place in the
+// node the key ends on.  A plain trie maps to void and stores nothing.
+template<typename V>
+class trie_payload {
+	typename std::aligned_storage<sizeof(V), alignof(V)>::type storage;
+
+public:
+	typedef V& reference;
+	static constexpr bool trivial = std::is_trivially_destructible<V>::value;
+
+	V& get() { return *reinterpret_cast<V*>(&storage); }
+	const V& get() const { return *reinterpret_cast<const V*>(&storage); }
+	template<typename... Args> void construct(Args&&... args) { new(&storage) V(std::forward<Args>(args)...); }
+	void copy_from(const trie_payload& other) { construct(other.get()); }
+	void destroy() { get().~V(); }
+
+	// Swaps two payloads, given whether each one holds a value.
+	static void swap(trie_payload& a, bool a_full, trie_payload& b, bool b_full) {
+		if(a_full && b_full) {
+			using std::swap;
+			swap(a.get(), b.get());
+		}
+		else if(a_full || b_full) {
+			trie_payload& from = a_full ? a : b;
+			(a_full ? b : a).construct(std::move(from.get()));
+			from.destroy();
+		}
+	}
+};
+
+template<>
+class trie_payload<void> {
+public:
+	typedef void reference;
+	static constexpr bool trivial = true;
+
+	template<typename... Args> void construct(Args&&...) {}
+	void copy_from(const trie_payload&) {}
+	void destroy() {}
+	static void swap(trie_payload&, bool, trie_payload&, bool) {}
+};
+
+// True for types a lookup can take in place of a key with symbols S:
+// anything whose cbegin() and cend() walk over S, like a string_view or a
+// std::vector<S>.
+template<typename K, typename S, typename = void>
+struct trie_key_like : std::false_type {};
+template<typename K, typename S>
+struct trie_key_like<K, S, typename std::enable_if<
+	std::is_same<typename std::decay<decltype(*std::declval<const K&>().cbegin())>::type, S>::value &&
+	std::is_same<decltype(std::declval<const K&>().cbegin()), decltype(std::declval<const K&>().cend())>::value>::type> :
+	std::true_type {};
+
+template<typename T> class double_array_trie;
+template<typename T> class dawg;
+template<typename T> class aho_corasick;
+
+// Alloc is an allocation policy from trie_allocator.h.  Every node and child
+// array of a trie comes from its own policy object.
+// Mapped is the value type of a trie_map (see trie_map.h), or void for a set.
+template<typename T, typename Alloc = trie_heap_allocator, typename Mapped = void>
 class trie {
+	template<typename> friend class double_array_trie;
+	template<typename> friend class louds_trie;
+	template<typename> friend class aho_corasick;
+
 	// data members and types
-	typedef std::vector<std::pair<typename T::value_type, std::unique_ptr<trie<T>>>> child_map_type;
-	child_map_type children;
-	bool is_leaf = false;
+	struct node;
+
+	// Sorted arrays of children, or ART-style arrays for byte symbols;
+	// see trie_children.h.
+	typedef typename T::value_type symbol;
+	typedef typename trie_children<symbol, node, Alloc>::type child_map_type;
+
+	struct node {
+		child_map_type children;
+		bool is_leaf;
+		// Constructed only while is_leaf is set
+		trie_payload<Mapped> payload;
+		// Number of keys in this subtree, counting the node's own key.
+		// A nullptr child is one key and has no node to keep a count in.
+		size_t count;
+
+		explicit node(bool is_leaf = false) : is_leaf{is_leaf}, count{is_leaf ? 1u : 0u} {}
+	};
+
+	static_assert(alignof(node) <= Alloc::alignment &&
+	              alignof(typename T::value_type) <= Alloc::alignment,
+	              "allocation policy is not aligned enough for this key type");
+
+	// Nodes of a trie whose policy frees everything at once can simply be
+	// forgotten, as long as the symbols and values don't need destructors to run.
+	static constexpr bool trivial_teardown = Alloc::bulk_release &&
+		std::is_trivially_destructible<typename T::value_type>::value && trie_payload<Mapped>::trivial;
+
+	// A key with a value needs a node to keep it in, so a trie_map never ends
+	// a key on a nullptr child.
+	static constexpr bool stores_values = !std::is_void<Mapped>::value;
+
+	node root;
+	Alloc alloc;
 
 public:
 	// misc. declarations
 	class iterator;
+	class key_cursor;
 	typedef T key_type;
 	typedef T value_type;
 	typedef size_t size_type;
+	typedef Alloc allocator_type;
 	typedef iterator const_iterator;
 
 	// constructors
 	trie(bool = false);
-	trie(const trie<T>&);
-	trie(trie<T>&&);
+	trie(const trie<T, Alloc, Mapped>&);
+	trie(trie<T, Alloc, Mapped>&&);
 	template<typename InputIt> trie(InputIt, InputIt, bool = false);
 	trie(std::initializer_list<T>);
 
-	// destructor, auto-generated one is fine
-	~trie() =default;
+	~trie();
 
 	// operators
-	trie<T>& operator=(trie<T>);
+	trie<T, Alloc, Mapped>& operator=(trie<T, Alloc, Mapped>);
 
 	// iterators and related
 	iterator begin() const;
 	iterator end() const;
 	const_iterator cbegin() const { return begin(); }
 	const_iterator cend() const { return end(); }
+	// For scans that only need each key in turn; see key_cursor.
+	key_cursor cursor() const { return key_cursor{&root}; }
 
 	// other members
 	std::pair<iterator,bool> insert(const value_type&);
+	std::pair<iterator,bool> insert(value_type&&);
 	template<typename InputIt> void insert(InputIt, const InputIt&);
+	template<typename... Args> std::pair<iterator,bool> emplace(Args&&...);
+	// Like insert(), but only says whether the key was new, so no iterator
+	// has to be built.
+	bool insert_key(const key_type&);
+	template<typename InputIt> void build_from_sorted(InputIt, InputIt);
+	// Inserts [first, last) on up to threads threads (0 for one per core).
+	// Keys are grouped by their first symbol, since each group only touches
+	// one subtree of the root, and each group is built on a thread of its own.
+	template<typename ForwardIt> void insert_parallel(ForwardIt, ForwardIt, unsigned threads = 0);
 
 	iterator erase(const_iterator);
 	size_type erase(const key_type&);
+	template<typename K, typename = typename std::enable_if<trie_key_like<K, symbol>::value>::type>
+	size_type erase(const K& key) { return erase_key(key.cbegin(), key.cend()); }
+	size_type erase(const symbol* key, size_type length) { return erase_key(key, key + length); }
 	iterator erase(const_iterator, const_iterator);
+	size_type erase_prefix(const key_type&);
 	void clear();
 
-	bool empty() const { return children.empty() && !is_leaf; }
+	bool empty() const { return root.children.empty() && !root.is_leaf; }
 	size_type size() const;
 	constexpr size_type max_size() const;
+	// Bytes taken by the trie, its nodes and their child arrays
+	size_type memory_usage() const;
 
 	const_iterator find(const key_type&) const;
 	size_type count(const key_type&) const;
+	bool contains(const key_type&) const;
+
+	// The same lookups straight from the caller's symbols, without making a
+	// key_type: from a key-like range (see trie_key_like), a pointer and a
+	// length, or a pair of forward iterators.
+	template<typename K, typename = typename std::enable_if<trie_key_like<K, symbol>::value>::type>
+	const_iterator find(const K& key) const { return find(key.cbegin(), key.cend()); }
+	const_iterator find(const symbol* key, size_type length) const { return find(key, key + length); }
+	template<typename ForwardIt> const_iterator find(ForwardIt, ForwardIt) const;
+	template<typename K, typename = typename std::enable_if<trie_key_like<K, symbol>::value>::type>
+	size_type count(const K& key) const { return contains(key) ? 1 : 0; }
+	size_type count(const symbol* key, size_type length) const { return contains(key, length) ? 1 : 0; }
+	template<typename ForwardIt> size_type count(ForwardIt first, ForwardIt last) const { return contains(first, last) ? 1 : 0; }
+	template<typename K, typename = typename std::enable_if<trie_key_like<K, symbol>::value>::type>
+	bool contains(const K& key) const { return contains(key.cbegin(), key.cend()); }
+	bool contains(const symbol* key, size_type length) const { return contains(key, key + length); }
+	template<typename ForwardIt> bool contains(ForwardIt, ForwardIt) const;
+
+	// Batched lookups: the result for each key in [first, last) is written
+	// to out, in order.  Several descents run side by side so that their
+	// cache misses overlap.  The keys may be key_type or key-like (see
+	// trie_key_like), and must stay put until the call returns.
+	template<typename ForwardIt, typename OutputIt> OutputIt find_many(ForwardIt, ForwardIt, OutputIt) const;
+	template<typename ForwardIt, typename OutputIt> OutputIt contains_many(ForwardIt, ForwardIt, OutputIt) const;
+
+	// prefix queries
+	std::pair<const_iterator,const_iterator> equal_prefix_range(const key_type&) const;
+	size_type count_prefix(const key_type&) const;
+	// The longest key that is a prefix of input, or end().  The input can
+	// also be key-like, a pointer and a length, or an iterator pair.
+	const_iterator longest_prefix_of(const key_type& input) const { return longest_prefix_of(input.cbegin(), input.cend()); }
+	template<typename K, typename = typename std::enable_if<trie_key_like<K, symbol>::value>::type>
+	const_iterator longest_prefix_of(const K& input) const { return longest_prefix_of(input.cbegin(), input.cend()); }
+	const_iterator longest_prefix_of(const symbol* input, size_type length) const { return longest_prefix_of(input, input + length); }
+	template<typename ForwardIt> const_iterator longest_prefix_of(ForwardIt, ForwardIt) const;
+	// Calls f(length) for every key that is a prefix of input, shortest
+	// first; the key is the first length symbols of input.
+	template<typename F> void prefixes_of(const key_type& input, F f) const { prefixes_of(input.cbegin(), input.cend(), f); }
+	template<typename K, typename F, typename = typename std::enable_if<trie_key_like<K, symbol>::value>::type>
+	void prefixes_of(const K& input, F f) const { prefixes_of(input.cbegin(), input.cend(), f); }
+	template<typename F> void prefixes_of(const symbol* input, size_type length, F f) const { prefixes_of(input, input + length, f); }
+	template<typename ForwardIt, typename F> void prefixes_of(ForwardIt, ForwardIt, F) const;
+
+	// traversal
+	// Calls f(key) for every key in order, or every key that starts with
+	// prefix.  Quicker than a loop over iterators: the walk is recursive and
+	// puts each key together in one reused buffer.
+	template<typename F> void for_each(F) const;
+	template<typename F> void for_each_prefix(const key_type&, F) const;
+	// Like for_each(), but the root's subtrees are walked on up to threads
+	// threads (0 for one per core), so f is called from several threads at
+	// once and in no particular order.
+	template<typename F> void parallel_for_each(F, unsigned threads = 0) const;
+
+	// approximate search
+	// Every key within max_distance edits (insertions, deletions and
+	// substitutions) of key, in order, with its distance.  With
+	// transpositions, swapping two adjacent symbols counts as one edit too,
+	// as long as neither is edited again (the optimal string alignment
+	// distance).  Subtrees that can't come within max_distance are skipped.
+	std::vector<std::pair<key_type,size_type>> fuzzy_find(const key_type&, size_type max_distance, bool transpositions = false) const;
+
+	// order statistics
+	const_iterator nth(size_type) const;
+	size_type rank(const key_type&) const;
 
-	void swap(trie<T>&);
-	static void swap(trie<T>& a, trie<T>& b) { a.swap(b); }
+	void swap(trie<T, Alloc, Mapped>&);
+	static void swap(trie<T, Alloc, Mapped>& a, trie<T, Alloc, Mapped>& b) { a.swap(b); }
+
+	// Writes a binary image that trie_view can use in place; see trie_image.h.
+	void write_image(std::ostream&) const;
+	// An immutable copy for fast lookups; defined in double_array_trie.h.
+	double_array_trie<T> freeze() const;
+	// A copy with equivalent subtrees merged; defined in dawg.h.
+	dawg<T> minimize() const;
+	// An automaton that finds every key in a text; defined in aho_corasick.h.
+	aho_corasick<T> matcher() const;
+
+protected:
+	// Used by trie_map to construct values and reach the nodes holding them.
+	template<typename K, typename... Args> std::pair<iterator,bool> insert_with(K&&, Args&&...);
+	template<typename... Args> node* insert_path(const key_type&, iterator*, bool&, Args&&...);
+	const node* find_node(const key_type&) const;
+
+private:
+	node* new_node(bool is_leaf = false);
+	void delete_node(node*);
+	void copy_children(node&, const node&);
+	void destroy_children(node&);
+	void destroy_all();
+	static void swap_roots(node&, node&);
+	uint64_t write_image(trie_image_writer<typename T::value_type>&, const node&) const;
+	void adjust_counts(const key_type&, std::ptrdiff_t);
+	bool descend(const key_type& key, iterator& it, const node*& n) const { return descend(key.cbegin(), key.cend(), it, n); }
+	template<typename ForwardIt> bool descend(ForwardIt, ForwardIt, iterator&, const node*&) const;
+	template<typename ForwardIt> size_type erase_key(ForwardIt, ForwardIt);
+	void unlink(typename iterator::path_type&);
+	size_type position(const iterator&) const;
+	void erase_run(iterator&, size_type);
+	static size_type count_of(const node* n) { return n == nullptr ? 1 : n->count; }
+
+	// One descent of find_many() or contains_many()
+	template<typename KeyIt> struct lane {
+		KeyIt at, end;
+		const node* n;
+		bool asked;  // n's child array has been prefetched
+		bool done, found;
+	};
+	static constexpr size_t batch_lanes = 16;
+	template<typename ForwardIt, typename KeyIt> size_t fill_lanes(ForwardIt&, const ForwardIt&, lane<KeyIt>*) const;
+	template<typename KeyIt, typename Step> void descend_lanes(lane<KeyIt>*, size_t, Step) const;
+	template<typename F> static void visit(const node&, key_type&, F&);
+	struct fuzzy_search;
+	static void fuzzy_visit(const node&, key_type&, const symbol*, fuzzy_search&);
+	static size_type memory_usage(const node&);
 };
 
-// Definition of trie<T>::iterator
+// Definition of trie<T, Alloc, Mapped>::iterator
 #include "trie_iterator.h"
 
-template<typename T>
-trie<T>::trie(bool is_leaf) :
-	is_leaf{is_leaf}
+template<typename T, typename Alloc, typename Mapped>
+auto trie<T, Alloc, Mapped>::new_node(bool is_leaf) -> node*
+{
+	return new(alloc.allocate(sizeof(node))) node{is_leaf};
+}
+
+template<typename T, typename Alloc, typename Mapped>
+void trie<T, Alloc, Mapped>::delete_node(node* n)
+{
+	// Also deletes everything under n.
+	if(n == nullptr)
+		return;
+	destroy_children(*n);
+	if(n->is_leaf)
+		n->payload.destroy();
+	n->~node();
+	alloc.deallocate(n, sizeof(node));
+}
+
+template<typename T, typename Alloc, typename Mapped>
+void trie<T, Alloc, Mapped>::copy_children(node& to, const node& from)
+{
+	// Each child is linked in before it is filled, so if anything throws,
+	// everything allocated so far is reachable from the root and gets cleaned up.
+	to.children.reserve(alloc, from.children.size());
+	for(auto slot = from.children.first(); slot != from.children.end_slot(); slot = from.children.next(slot)) {
+		auto i = to.children.emplace(alloc, to.children.end_slot(), from.children.symbol(slot), nullptr);
+		if(const node* child = from.children.child(slot)) {
+			node* copy = to.children.child(i) = new_node();
+			if(child->is_leaf) {
+				copy->payload.copy_from(child->payload);
+				copy->is_leaf = true;
+			}
+			copy->count = child->count;
+			copy_children(*copy, *child);
+		}
+	}
+}
+
+template<typename T, typename Alloc, typename Mapped>
+void trie<T, Alloc, Mapped>::destroy_children(node& n)
+{
+	for(auto slot = n.children.first(); slot != n.children.end_slot(); slot = n.children.next(slot))
+		delete_node(n.children.child(slot));
+	n.children.clear(alloc);
+}
+
+template<typename T, typename Alloc, typename Mapped>
+void trie<T, Alloc, Mapped>::destroy_all()
+{
+	// Leaves the trie empty.
+	if(root.is_leaf)
+		root.payload.destroy();
+	root.is_leaf = false;
+	root.count = 0;
+	if(trivial_teardown)
+		// No need to visit the nodes, just drop all the memory at once.
+		root.children.forget();
+	else
+		destroy_children(root);
+	alloc.release();
+}
+
+template<typename T, typename Alloc, typename Mapped>
+void trie<T, Alloc, Mapped>::swap_roots(node& a, node& b)
+{
+	a.children.swap(b.children);
+	trie_payload<Mapped>::swap(a.payload, a.is_leaf, b.payload, b.is_leaf);
+	std::swap(a.is_leaf, b.is_leaf);
+	std::swap(a.count, b.count);
+}
+
+template<typename T, typename Alloc, typename Mapped>
+void trie<T, Alloc, Mapped>::adjust_counts(const key_type& key, std::ptrdiff_t delta)
+{
+	// Adds delta to the count of every node on the path to key, which must
+	// already be in the trie.
+	node* currentNode = &root;
+	for(auto inputIt = key.cbegin(); currentNode != nullptr; ++inputIt) {
+		currentNode->count += delta;
+		if(inputIt == key.cend())
+			break;
+		currentNode = currentNode->children.child(currentNode->children.find(*inputIt));
+	}
+}
+
+template<typename T, typename Alloc, typename Mapped>
+template<typename ForwardIt>
+bool trie<T, Alloc, Mapped>::descend(ForwardIt first, ForwardIt last, iterator& it, const node*& currentNode) const
+{
+	// Follows [first, last) from the root, pushing a state onto it for every
+	// child taken.  Returns false if the key leaves the trie.  Otherwise
+	// currentNode is the node the key ends on, or nullptr if it ends on a
+	// nullptr child.
+	currentNode = &root;
+	for(auto inputIt = first; inputIt != last; ++inputIt) {
+		if(currentNode == nullptr)
+			// We passed a nullptr child, which ends a key, with symbols to spare.
+			return false;
+		auto index = currentNode->children.find(*inputIt);
+		if(index == child_map_type::npos)
+			// Child is not found
+			return false;
+		it.parents.push({currentNode, index});
+		currentNode = currentNode->children.child(index);
+	}
+	return true;
+}
+
+template<typename T, typename Alloc, typename Mapped>
+void trie<T, Alloc, Mapped>::unlink(typename iterator::path_type& parents)
+{
+	// Deletes the child the top state points at, along with everything under
+	// it and any node that is left holding no key.
+	// The const_cast<>s here are actually not bad design.
+	// The reason for this is that the states must come from *this, and
+	// because this non-const function is executing, the nodes must be non-const!
+	while(!parents.top().node->is_leaf && parents.top().node->children.size() == 1 && parents.size() > 1)
+		parents.pop();
+
+	// This drops the child's whole chain of now-unneeded nodes.
+	node* top = const_cast<node*>(parents.top().node);
+	auto index = parents.top().index;
+	delete_node(top->children.child(index));
+	top->children.erase(alloc, index);
+
+	if(!stores_values && top->children.size() == 0 && parents.size() > 1) {
+		// A leaf with no children left becomes a nullptr child.
+		parents.pop();
+		node*& link = const_cast<node*>(parents.top().node)->children.child(parents.top().index);
+		delete_node(link);
+		link = nullptr;
+	}
+}
+
+template<typename T, typename Alloc, typename Mapped>
+trie<T, Alloc, Mapped>::trie(bool is_leaf) :
+	root{is_leaf}
 {}
 
-template<typename T>
-trie<T>::trie(const trie<T>& other) :
-	is_leaf{other.is_leaf}
+template<typename T, typename Alloc, typename Mapped>
+trie<T, Alloc, Mapped>::trie(const trie<T, Alloc, Mapped>& other) :
+	root{false}, alloc{other.alloc}
 {
+	if(other.root.is_leaf) {
+		root.payload.copy_from(other.root.payload);
+		root.is_leaf = true;
+	}
+	root.count = other.root.count;
 	// Deep copy the children
-	children.reserve(other.children.size());
-	for(const auto& it : other.children) {
-		// Separate creation of unique_ptr for exception safety
-		std::unique_ptr<trie<T>> p(it.second == nullptr ? nullptr : new trie<T>(*it.second));
-		children.emplace(children.end(), it.first, std::move(p));
+	try {
+		copy_children(root, other.root);
+	}
+	catch(...) {
+		destroy_all();
+		throw;
 	}
 }
 
-template<typename T>
-trie<T>::trie(trie<T>&& other) :
-	children{std::move(other.children)}, is_leaf{other.is_leaf}
-{}
+template<typename T, typename Alloc, typename Mapped>
+trie<T, Alloc, Mapped>::trie(trie<T, Alloc, Mapped>&& other) :
+	root{false}, alloc{std::move(other.alloc)}
+{
+	swap_roots(root, other.root);
+}
 
-template<typename T>
+template<typename T, typename Alloc, typename Mapped>
 template<typename InputIt>
-trie<T>::trie(const InputIt begin, const InputIt end, bool is_leaf) :
-	is_leaf{is_leaf}
+trie<T, Alloc, Mapped>::trie(const InputIt begin, const InputIt end, bool is_leaf) :
+	root{is_leaf}
 {
-	for(auto x = begin; x != end; ++x)
-		insert(*x);
+	try {
+		for(auto x = begin; x != end; ++x)
+			insert_key(*x);
+	}
+	catch(...) {
+		destroy_all();
+		throw;
+	}
 }
 
-template<typename T>
-trie<T>::trie(std::initializer_list<T> l) :
-	is_leaf{false}
+template<typename T, typename Alloc, typename Mapped>
+trie<T, Alloc, Mapped>::trie(std::initializer_list<T> l) :
+	root{false}
 {
-	for(const auto& e: l)
-		insert(e);
+	try {
+		for(const auto& e: l)
+			insert_key(e);
+	}
+	catch(...) {
+		destroy_all();
+		throw;
+	}
 }
 
-template<typename T>
-trie<T>& trie<T>::operator=(trie<T> other)
+template<typename T, typename Alloc, typename Mapped>
+trie<T, Alloc, Mapped>::~trie()
+{
+	destroy_all();
+}
+
+template<typename T, typename Alloc, typename Mapped>
+trie<T, Alloc, Mapped>& trie<T, Alloc, Mapped>::operator=(trie<T, Alloc, Mapped> other)
 {
 	swap(*this, other);
 	return *this;
 }
 
-template<typename T>
-auto trie<T>::begin() const -> iterator
+template<typename T, typename Alloc, typename Mapped>
+auto trie<T, Alloc, Mapped>::begin() const -> iterator
 {
 	// We'll let the iterator fall down to the first valid value.
-	return {this};
+	return {&root};
 }
 
-template<typename T>
-auto trie<T>::end() const -> iterator
+template<typename T, typename Alloc, typename Mapped>
+auto trie<T, Alloc, Mapped>::end() const -> iterator
 {
 	// Here's where we use our friend privileges
-	std::stack<typename iterator::state> temp;
-	temp.push({this, this->children.cend()});
-	T built;
-	built.reserve(16);
-	return {std::move(temp), std::move(built), true, false};
+	typename iterator::path_type temp;
+	temp.push({&root, root.children.end_slot()});
+	return {std::move(temp), true};
+}
+
+template<typename T, typename Alloc, typename Mapped>
+auto trie<T, Alloc, Mapped>::insert(const value_type& value) -> std::pair<iterator,bool>
+{
+	return insert_with(value);
 }
 
-template<typename T>
-auto trie<T>::insert(const value_type& value) -> std::pair<iterator,bool>
+template<typename T, typename Alloc, typename Mapped>
+auto trie<T, Alloc, Mapped>::insert(value_type&& value) -> std::pair<iterator,bool>
 {
-	bool inserted = false;
-	iterator it;
-	decltype(this) currentNode = this;
+	return insert_with(std::move(value));
+}
 
-	if(value.empty()) {
-		// Special case for empty value
-		if(!currentNode->is_leaf) {
+template<typename T, typename Alloc, typename Mapped>
+template<typename... Args>
+auto trie<T, Alloc, Mapped>::emplace(Args&&... args) -> std::pair<iterator,bool>
+{
+	return insert(value_type(std::forward<Args>(args)...));
+}
+
+template<typename T, typename Alloc, typename Mapped>
+bool trie<T, Alloc, Mapped>::insert_key(const key_type& key)
+{
+	bool inserted;
+	insert_path(key, nullptr, inserted);
+	return inserted;
+}
+
+template<typename T, typename Alloc, typename Mapped>
+template<typename K, typename... Args>
+auto trie<T, Alloc, Mapped>::insert_with(K&& key, Args&&... args) -> std::pair<iterator,bool>
+{
+	bool inserted;
+	iterator it{typename iterator::path_type{}, false};
+	insert_path(key, &it, inserted, std::forward<Args>(args)...);
+	// An rvalue key is done with, so it can be moved into the iterator;
+	// otherwise the iterator puts the key together if it is dereferenced.
+	if(std::is_rvalue_reference<K&&>::value)
+		it.set_key(std::move(key));
+	return {std::move(it),inserted};
+}
+
+template<typename T, typename Alloc, typename Mapped>
+template<typename... Args>
+auto trie<T, Alloc, Mapped>::insert_path(const key_type& value, iterator* it, bool& inserted, Args&&... args) -> node*
+{
+	// Adds value if it is new, constructing its payload from args, and returns
+	// the node it ends on (nullptr for a nullptr child).  If it is given, the
+	// path is pushed onto it.
+	inserted = false;
+	node* currentNode = &root;
+	// The nodes passed on the way down, so that their counts can be raised
+	// at the end without descending again
+	typename iterator::path_type own_path;
+	auto& path = it != nullptr ? it->parents : own_path;
+
+	for(auto inputIt = value.cbegin(); inputIt != value.cend(); ++inputIt) {
+		bool is_last = (inputIt + 1 == value.end());
+
+		auto index = currentNode->children.find(*inputIt);
+		if(index == child_map_type::npos) {
+			// Child is new.  Insert it with a link, to nullptr if it's the last.
+			inserted = true;
+
+			// Link the child in before allocating its node, so a failed
+			// allocation can't leave an unreachable node behind.
+			index = currentNode->children.emplace(alloc, currentNode->children.lower_bound(*inputIt), *inputIt, nullptr);
+			if(!is_last || stores_values)
+				currentNode->children.child(index) = new_node();
+		}
+		else if(currentNode->children.child(index) == nullptr && !is_last) {
+			// The key so far was stored as a nullptr child.
+			// Change it to a node with a leaf flag, so we can continue below it.
+			currentNode->children.child(index) = new_node(true);
 			inserted = true;
-			currentNode->is_leaf = true;
 		}
-		it.parents.emplace(currentNode, currentNode->children.begin());
-		it.at_leaf = true;
+
+		path.push({currentNode, index});
+		currentNode = currentNode->children.child(index);
 	}
-	else
-		for(auto inputIt = value.cbegin(); inputIt != value.cend(); ++inputIt) {
-			bool is_last = (inputIt + 1 == value.end());
-
-			// A clever application of <= here allows us to re-use the iterator for emplace,
-			// should the requested element not be found.
-			auto childIt = std::upper_bound(currentNode->children.begin(), currentNode->children.end(), *inputIt,
-			                                [&inputIt](const typename T::value_type& x, const std::pair<typename T::value_type,std::unique_ptr<trie<T>>>& y)
-			                                          { return x <= y.first; });
-			// We must check if the iterator is at the end before trying to dereference it.
-			if(childIt == currentNode->children.end() || childIt->first != *inputIt) {
-				// Child is new.  Insert it with a link, to nullptr if it's the last.
-				inserted = true;
-
-				decltype(this) newtrie {is_last ? nullptr : new trie<T>};
-
-				// FIXME Inconsistent unique_ptr construction
-				it.parents.emplace(currentNode,
-					currentNode->children.emplace(childIt, *inputIt, std::unique_ptr<trie<T>>(newtrie))
-				);
-
-				currentNode = newtrie;
+
+	if(currentNode != nullptr) {
+		// The key ends on a node, rather than a nullptr child.
+		if(!currentNode->is_leaf) {
+			try {
+				currentNode->payload.construct(std::forward<Args>(args)...);
 			}
-			else {
-				// Child is found.  Move to it if it isn't nullptr.
-				// If it is nullptr, change it to a node with a leaf flag.
-				if(is_last) {
-					it.parents.emplace(currentNode, childIt);
-					if(childIt->second.get() != nullptr) {
-						// Basically descend *twice*
-						currentNode = childIt->second.get();
-						if(!currentNode->is_leaf) {
-							inserted = true;
-							currentNode->is_leaf = true;
-						}
-						it.parents.emplace(currentNode, currentNode->children.begin());
-						it.at_leaf = true;
-					}
-				}
-				else {
-					if(childIt->second.get() == nullptr) {
-						childIt->second.reset(new trie<T>{true});
-						inserted = true;
-					}
-					// Child now definitely exists, move to it.
-					it.parents.emplace(currentNode, childIt);
-					currentNode = childIt->second.get();
+			catch(...) {
+				// Don't leave behind the nodes we made for this key.
+				if(currentNode != &root && currentNode->children.empty()) {
+					iterator path{typename iterator::path_type{}, false};
+					const node* ignored;
+					descend(value, path, ignored);
+					unlink(path.parents);
 				}
+				throw;
 			}
+			inserted = true;
+			currentNode->is_leaf = true;
 		}
-	it.built = value;
-	return {std::move(it),inserted};
+	}
+
+	if(inserted) {
+		// The nodes are ours, so the const_cast<>s are fine; see unlink().
+		for(size_t i = 0; i < path.size(); ++i)
+			++const_cast<node*>(path[i].node)->count;
+		if(currentNode != nullptr)
+			++currentNode->count;
+	}
+	if(it != nullptr && currentNode != nullptr)
+		it->parents.push({currentNode, iterator::npos});
+	return currentNode;
 }
 
-template<typename T>
+template<typename T, typename Alloc, typename Mapped>
 template<typename InputIt>
-void trie<T>::insert(InputIt start, const InputIt& finish)
+void trie<T, Alloc, Mapped>::insert(InputIt start, const InputIt& finish)
 {
 	while(start != finish)
-		insert(*(start++));
+		insert_key(*(start++));
+}
+
+template<typename T, typename Alloc, typename Mapped>
+template<typename ForwardIt>
+void trie<T, Alloc, Mapped>::insert_parallel(ForwardIt first, ForwardIt last, unsigned threads)
+{
+	static_assert(!stores_values, "insert_parallel() has no values to store");
+	if(threads == 0)
+		threads = std::thread::hardware_concurrency();
+	if(threads <= 1) {
+		// Grouping the keys would only cost time.
+		insert(first, last);
+		return;
+	}
+
+	// The empty key only touches the root, and is added here.  The rest
+	// are grouped by first symbol; std::map keeps the groups in the root's order.
+	std::map<symbol, std::vector<ForwardIt>> by_symbol;
+	for(; first != last; ++first) {
+		if((*first).cbegin() == (*first).cend())
+			insert_key(*first);
+		else
+			by_symbol[*(*first).cbegin()].push_back(first);
+	}
+	if(by_symbol.empty())
+		return;
+
+	// Each group goes into a trie of its own, with its own allocation policy
+	// so the threads never share one.  If the root already has a child for
+	// the symbol, the group's trie starts out with it, and the worker adds to
+	// it in place.  Nothing else in *this is touched until the threads are done.
+	struct group {
+		symbol s;
+		std::vector<ForwardIt>* keys;
+		trie part;
+		size_type before;  // keys the root's child already had
+		std::exception_ptr error;
+	};
+	std::vector<group> groups;
+	groups.reserve(by_symbol.size());
+	size_t fresh = 0;
+	for(const auto& g: by_symbol)
+		if(root.children.find(g.first) == child_map_type::npos)
+			++fresh;
+	// Make room now, so hanging the groups in can't fail half way.
+	root.children.reserve(alloc, root.children.size() + fresh);
+	for(auto& g: by_symbol) {
+		groups.push_back(group{g.first, &g.second, trie{}, 0, nullptr});
+		trie& part = groups.back().part;
+		part.alloc = Alloc{alloc};
+		auto slot = root.children.find(g.first);
+		if(slot != child_map_type::npos) {
+			node* existing = root.children.child(slot);
+			part.root.children.emplace(part.alloc, part.root.children.end_slot(), g.first, existing);
+			part.root.count = groups.back().before = count_of(existing);
+		}
+	}
+	// The biggest groups go first, so no thread is left with a big one at the end.
+	std::vector<group*> order;
+	for(auto& g: groups)
+		order.push_back(&g);
+	std::stable_sort(order.begin(), order.end(), [](const group* a, const group* b) {
+		return a->keys->size() > b->keys->size();
+	});
+
+	std::atomic<size_t> next{0};
+	auto work = [&]() {
+		for(;;) {
+			size_t i = next++;
+			if(i >= order.size())
+				return;
+			group& g = *order[i];
+			try {
+				for(auto key: *g.keys)
+					g.part.insert_key(*key);
+			}
+			catch(...) {
+				g.error = std::current_exception();
+			}
+		}
+	};
+	if(threads > groups.size())
+		threads = groups.size();
+	std::vector<std::thread> pool;
+	try {
+		for(unsigned i = 1; i < threads; ++i)
+			pool.emplace_back(work);
+	}
+	catch(...) {
+		// Too few threads is not an error; the rest of the work is done below.
+	}
+	work();
+	for(auto& t: pool)
+		t.join();
+
+	// Hang every group's subtree under the root, and take over its memory,
+	// whether or not its worker finished.
+	std::exception_ptr error;
+	for(auto& g: groups) {
+		if(!g.part.root.children.empty()) {
+			node*& link = g.part.root.children.child(g.part.root.children.first());
+			auto slot = root.children.find(g.s);
+			if(slot == child_map_type::npos) {
+				root.children.emplace(alloc, root.children.lower_bound(g.s), g.s, link);
+				root.count += count_of(link);
+			}
+			else {
+				// The worker may have added to the very node the root points at.
+				root.count += count_of(link) - g.before;
+				root.children.child(slot) = link;
+			}
+			link = nullptr;
+			g.part.root.children.clear(g.part.alloc);
+		}
+		g.part.root.count = 0;
+		alloc.adopt(g.part.alloc);
+		if(g.error && !error)
+			error = g.error;
+	}
+	if(error)
+		std::rethrow_exception(error);
 }
 
-template<typename T>
-auto trie<T>::erase(const_iterator it) -> iterator
+template<typename T, typename Alloc, typename Mapped>
+template<typename InputIt>
+void trie<T, Alloc, Mapped>::build_from_sorted(InputIt first, InputIt last)
 {
-	auto nextit(it);
-	++nextit;
+	// Replaces the contents with the keys in [first, last), which must be in
+	// the trie's order (duplicates are skipped).  Each key only costs the
+	// symbols past its common prefix with the previous one.
+	static_assert(!stores_values, "build_from_sorted() has no values to store");
+	clear();
 
-	// The const_cast<>s here are actually not bad design.
-	// The reason for this is that the iterator must be an iterator of *this,
-	// or behavior is undefined.  Because this non-const function is executing,
-	// it means that the pointer must be to a non-const trie<T>!
+	// Keys are added along the right edge of the trie.  The children of each
+	// node on that edge wait in pending, by depth, until a later key leaves the
+	// node behind; then they go into it all at once, in an exactly sized array.
+	// The last child at each depth leads to the next node on the edge, which is
+	// only allocated when it gets a child of its own.
+	std::vector<std::vector<std::pair<symbol, node*>>> pending(1);
+	size_t depth = 0;  // of the previous key
+	bool started = false;
 
-	if(it.at_leaf)
-		const_cast<trie<T>*&>(it.parents.top().node)->is_leaf = false;
-	else {
-		while(!it.parents.top().node->is_leaf && it.parents.top().node->children.size() == 1 && it.parents.size() > 1)
-			it.parents.pop();
-
-		// Because GCC 4.8.x does not implement the C++11 function with signature
-		//    auto std::vector<T>::erase(const_iterator) -> iterator
-		// You may required to use this comparatively nasty (and slower) construct:
-		//auto nonconst_it = const_cast<trie<T>*&>(it.parents.top().node)->children.begin();
-		//std::advance(nonconst_it, std::distance(it.parents.top().node->children.cbegin(), it.parents.top().node_map_it));
-		//const_cast<trie<T>*&>(it.parents.top().node)->children.erase(nonconst_it);
-		const_cast<trie<T>*&>(it.parents.top().node)->children.erase(it.parents.top().node_map_it);
-
-		if(it.parents.top().node->children.size() == 0 && it.parents.size() > 1) {
-			it.parents.pop();
-			const_cast<std::unique_ptr<trie<T>>&>(it.parents.top().node_map_it->second).reset(nullptr);
+	auto fill = [this](node& n, std::vector<std::pair<symbol, node*>>& children) {
+		n.children.reserve(alloc, children.size());
+		for(auto& c: children) {
+			n.children.emplace(alloc, n.children.end_slot(), c.first, c.second);
+			n.count += count_of(c.second);
+			c.second = nullptr;
 		}
+		children.clear();
+	};
+
+	try {
+		for(; first != last; ++first) {
+			const auto& key = *first;
+			auto inputIt = key.cbegin();
+			size_t d = 0;
+			while(d < depth && inputIt != key.cend() && *inputIt == pending[d].back().first) {
+				++inputIt;
+				++d;
+			}
+			if(started) {
+				if(inputIt == key.cend()) {
+					if(d == depth)
+						continue;
+					throw std::invalid_argument("trie::build_from_sorted: keys are not sorted");
+				}
+				if(d < depth && !(pending[d].back().first < *inputIt))
+					throw std::invalid_argument("trie::build_from_sorted: keys are not sorted");
+			}
+
+			// Finish the nodes below the common prefix.
+			for(; depth > d; --depth)
+				if(node* n = pending[depth - 1].back().second)
+					fill(*n, pending[depth]);
+
+			for(; inputIt != key.cend(); ++inputIt, ++d) {
+				// The node at depth d is new, unless it's on the common prefix.
+				if(d > 0 && pending[d - 1].back().second == nullptr)
+					pending[d - 1].back().second = new_node(d == depth);
+				if(pending.size() == d)
+					pending.emplace_back();
+				pending[d].push_back({*inputIt, nullptr});
+			}
+			if(d == 0) {
+				root.is_leaf = true;
+				root.count = 1;
+			}
+			depth = d;
+			started = true;
+		}
+
+		for(; depth > 0; --depth)
+			if(node* n = pending[depth - 1].back().second)
+				fill(*n, pending[depth]);
+		fill(root, pending[0]);
+	}
+	catch(...) {
+		// Nodes not yet linked into the trie are only reachable from pending.
+		for(auto& children: pending)
+			for(auto& c: children)
+				delete_node(c.second);
+		clear();
+		throw;
 	}
+}
+
+template<typename T, typename Alloc, typename Mapped>
+auto trie<T, Alloc, Mapped>::erase(const_iterator it) -> iterator
+{
+	// The iterator is walked on to the next key as its own is erased.
+	erase_run(it, 1);
+	return it;
+}
 
-	// Because the child list is a vector, we must re-find the next value, because iterators have been invalidated.
-	// It doesn't need to be recreated if the iterator is at_end.
-	return nextit.at_end ? end() : find(*nextit);
+template<typename T, typename Alloc, typename Mapped>
+auto trie<T, Alloc, Mapped>::erase(const key_type& key) -> size_type
+{
+	return erase_key(key.cbegin(), key.cend());
 }
 
-template<typename T>
-auto trie<T>::erase(const key_type& key) -> size_type
+template<typename T, typename Alloc, typename Mapped>
+template<typename ForwardIt>
+auto trie<T, Alloc, Mapped>::erase_key(ForwardIt first, ForwardIt last) -> size_type
 {
-	auto found = find(key);
+	auto found = find(first, last);
 	if(found == end())
 		return 0;
 	else {
@@ -275,93 +898,678 @@ auto trie<T>::erase(const key_type& key) -> size_type
 	}
 }
 
-template<typename T>
-auto trie<T>::erase(const_iterator first, const_iterator last) -> iterator
+template<typename T, typename Alloc, typename Mapped>
+auto trie<T, Alloc, Mapped>::erase(const_iterator first, const_iterator last) -> iterator
 {
-	while(first != last)
-		first = erase(first);
-
-	return last;
+	// last's path may not survive the erase, so go by how many keys to drop.
+	erase_run(first, position(last) - position(first));
+	return first;
 }
 
-template<typename T>
-void trie<T>::clear()
+template<typename T, typename Alloc, typename Mapped>
+auto trie<T, Alloc, Mapped>::position(const iterator& it) const -> size_type
 {
-	is_leaf = false;
-	children.clear();
+	// The number of keys before it, like rank(), but from its path.
+	if(it.at_end)
+		return size();
+	size_type before = 0;
+	for(size_t i = 0; i < it.parents.size() && it.parents[i].index != iterator::npos; ++i) {
+		const node* n = it.parents[i].node;
+		if(n->is_leaf)
+			++before;
+		for(auto slot = n->children.first(); slot != it.parents[i].index; slot = n->children.next(slot))
+			before += count_of(n->children.child(slot));
+	}
+	return before;
 }
 
-template<typename T>
-auto trie<T>::size() const -> size_type
+template<typename T, typename Alloc, typename Mapped>
+void trie<T, Alloc, Mapped>::erase_run(iterator& it, size_type n)
 {
-	size_type s = is_leaf ? 1 : 0;
-	for(const auto& child : children)
-		if(child.second != nullptr)
-			s += child.second->size();
+	// Erases the n keys starting at it and leaves it at the key after them.
+	// Each step drops the biggest subtree that starts at it and holds no more
+	// than what is left to erase, so a range goes a subtree at a time.  Only
+	// the child array the subtree hung from changes, and it is the top of the
+	// path afterwards, so it is moved on by symbol rather than re-found.
+	// The iterator must be an iterator of *this, or behavior is undefined,
+	// so its nodes are ours to change.
+	auto& path = it.parents;
+	while(n > 0) {
+		// The subtree is the child at path[level].index, and holds taken keys.
+		size_t level = path.size() - 1;
+		size_type taken = 1;
+		if(path.top().index == iterator::npos) {
+			node* own = const_cast<node*>(path.top().node);
+			if(own->count > n || level == 0) {
+				if(own->count <= n) {
+					clear();
+					it = end();
+					return;
+				}
+				// Just the node's own key goes; its children stay.
+				own->payload.destroy();
+				own->is_leaf = false;
+				for(size_t i = 0; i < path.size(); ++i)
+					--const_cast<node*>(path[i].node)->count;
+				--n;
+				++it;
+				continue;
+			}
+			taken = own->count;
+			it.pop();
+			--level;
+		}
+		for(;;) {
+			const node* parent = path[level].node;
+			if(parent->is_leaf || path[level].index != parent->children.first() || parent->count > n)
+				break;
+			// it is the first key under parent, and everything there goes.
+			if(level == 0) {
+				clear();
+				it = end();
+				return;
+			}
+			taken = parent->count;
+			it.pop();
+			--level;
+		}
+
+		node* parent = const_cast<node*>(path.top().node);
+		for(size_t i = 0; i < path.size(); ++i)
+			const_cast<node*>(path[i].node)->count -= taken;
+		n -= taken;
+
+		auto index = path.top().index;
+		auto next = parent->children.next(index);
+		bool has_next = next != parent->children.end_slot();
+		symbol next_symbol{};
+		if(has_next)
+			next_symbol = parent->children.symbol(next);
+		delete_node(parent->children.child(index));
+		parent->children.erase(alloc, index);
+
+		if(has_next)
+			// The array may have shifted or changed kind, but the symbol stays.
+			it.set_top_index(parent->children.find(next_symbol));
+		else if(!stores_values && parent->children.empty() && level > 0) {
+			// A leaf with no children left becomes a nullptr child, which
+			// comes before anything still to come.
+			it.pop();
+			node*& link = const_cast<node*>(path.top().node)->children.child(path.top().index);
+			delete_node(link);
+			link = nullptr;
+			it.leave_child();
+		}
 		else
-			++s;
-	return s;
+			it.set_top_index(parent->children.end_slot());
+		it.fall_down();
+	}
+}
+
+template<typename T, typename Alloc, typename Mapped>
+auto trie<T, Alloc, Mapped>::erase_prefix(const key_type& prefix) -> size_type
+{
+	// Drops the whole subtree under prefix at once.
+	if(prefix.empty()) {
+		size_type removed = size();
+		clear();
+		return removed;
+	}
+
+	iterator it{typename iterator::path_type{}, false};
+	const node* subtree;
+	if(!descend(prefix, it, subtree))
+		return 0;
+	size_type removed = count_of(subtree);
+	adjust_counts(prefix, -static_cast<std::ptrdiff_t>(removed));
+	unlink(it.parents);
+	return removed;
 }
 
-template<typename T>
-auto trie<T>::find(const key_type& key) const -> const_iterator
+template<typename T, typename Alloc, typename Mapped>
+void trie<T, Alloc, Mapped>::clear()
 {
-	iterator it{std::stack<typename iterator::state>{}, key, false, false};
-	decltype(this) currentNode{this};
+	destroy_all();
+}
+
+template<typename T, typename Alloc, typename Mapped>
+auto trie<T, Alloc, Mapped>::size() const -> size_type
+{
+	return root.count;
+}
+
+template<typename T, typename Alloc, typename Mapped>
+auto trie<T, Alloc, Mapped>::memory_usage() const -> size_type
+{
+	return sizeof(*this) - sizeof(node) + memory_usage(root);
+}
+
+template<typename T, typename Alloc, typename Mapped>
+auto trie<T, Alloc, Mapped>::memory_usage(const node& n) -> size_type
+{
+	size_type bytes = sizeof(node) + n.children.allocated_bytes();
+	for(auto slot = n.children.first(); slot != n.children.end_slot(); slot = n.children.next(slot))
+		if(const node* child = n.children.child(slot))
+			bytes += memory_usage(*child);
+	return bytes;
+}
 
-	if(key.empty()) {
-		// Special case for empty value
-		if(!this->is_leaf)
+template<typename T, typename Alloc, typename Mapped>
+auto trie<T, Alloc, Mapped>::find(const key_type& key) const -> const_iterator
+{
+	return find(key.cbegin(), key.cend());
+}
+
+template<typename T, typename Alloc, typename Mapped>
+template<typename ForwardIt>
+auto trie<T, Alloc, Mapped>::find(ForwardIt first, ForwardIt last) const -> const_iterator
+{
+	const node* currentNode;
+	iterator it{typename iterator::path_type{}, false};
+	if(!descend(first, last, it, currentNode))
+		return cend();
+
+	if(currentNode != nullptr) {
+		// The key ends on a node, so that node must hold it.
+		if(!currentNode->is_leaf)
 			return cend();
-		else {
-			it.parents.emplace(currentNode, currentNode->children.cbegin());
-			it.at_leaf = true;
-		}
+		it.parents.push({currentNode, iterator::npos});
 	}
-	else
-		for(auto inputIt = key.cbegin(); inputIt != key.cend(); ++inputIt) {
-			auto childIt = std::upper_bound(currentNode->children.cbegin(), currentNode->children.cend(), *inputIt,
-			                                [&inputIt](const typename T::value_type& x, const std::pair<typename T::value_type,std::unique_ptr<trie<T>>>& y)
-			                                          { return x <= y.first; });
-			if(childIt == currentNode->children.end() || childIt->first != *inputIt)
-				// Child is not found
-				return cend();
+	return it;
+}
+
+template<typename T, typename Alloc, typename Mapped>
+auto trie<T, Alloc, Mapped>::count(const key_type& key) const -> size_type
+{
+	return contains(key) ? 1 : 0;
+}
+
+template<typename T, typename Alloc, typename Mapped>
+bool trie<T, Alloc, Mapped>::contains(const key_type& key) const
+{
+	return contains(key.cbegin(), key.cend());
+}
+
+template<typename T, typename Alloc, typename Mapped>
+template<typename ForwardIt>
+bool trie<T, Alloc, Mapped>::contains(ForwardIt first, ForwardIt last) const
+{
+	// Same descent as find(), but without building an iterator,
+	// so it never allocates or copies the key.
+	const node* currentNode{&root};
+
+	for(auto inputIt = first; inputIt != last; ) {
+		auto index = currentNode->children.find(*inputIt);
+		if(index == child_map_type::npos)
+			return false;
+		const node* child = currentNode->children.child(index);
+		if(child == nullptr)
+			// A nullptr child ends a key, so it only matches on the last symbol.
+			return ++inputIt == last;
+		currentNode = child;
+		++inputIt;
+	}
+	return currentNode->is_leaf;
+}
+
+template<typename T, typename Alloc, typename Mapped>
+template<typename ForwardIt, typename OutputIt>
+OutputIt trie<T, Alloc, Mapped>::find_many(ForwardIt first, ForwardIt last, OutputIt out) const
+{
+	typedef decltype((*first).cbegin()) key_iterator;
+	lane<key_iterator> lanes[batch_lanes];
+	typename iterator::path_type paths[batch_lanes];
+	while(first != last) {
+		size_t used = fill_lanes(first, last, lanes);
+		descend_lanes(lanes, used, [&](size_t i, const node* n, typename child_map_type::size_type slot) {
+			paths[i].push({n, slot});
+		});
+		for(size_t i = 0; i < used; ++i) {
+			if(!lanes[i].found)
+				*out++ = cend();
 			else {
-				// Child is found.  Move to it.
-				bool is_last = (inputIt + 1 == key.end());
-				if(is_last) {
-					it.parents.emplace(currentNode, childIt);
-					if(childIt->second.get() != nullptr) {
-						// Basically descend *twice*
-						currentNode = childIt->second.get();
-						if(!currentNode->is_leaf)
-							return cend();
-						else {
-							it.parents.emplace(currentNode, currentNode->children.begin());
-							it.at_leaf = true;
-						}
-					}
-				}
-				else {
-					if(childIt->second.get() == nullptr)
-						return cend();
-					// Child now definitely exists, move to it.
-					it.parents.emplace(currentNode, childIt);
-					currentNode = childIt->second.get();
+				if(lanes[i].n != nullptr)
+					paths[i].push({lanes[i].n, iterator::npos});
+				*out++ = iterator{std::move(paths[i]), false};
+			}
+			paths[i] = typename iterator::path_type{};
+		}
+	}
+	return out;
+}
+
+template<typename T, typename Alloc, typename Mapped>
+template<typename ForwardIt, typename OutputIt>
+OutputIt trie<T, Alloc, Mapped>::contains_many(ForwardIt first, ForwardIt last, OutputIt out) const
+{
+	typedef decltype((*first).cbegin()) key_iterator;
+	lane<key_iterator> lanes[batch_lanes];
+	while(first != last) {
+		size_t used = fill_lanes(first, last, lanes);
+		descend_lanes(lanes, used, [](size_t, const node*, typename child_map_type::size_type) {});
+		for(size_t i = 0; i < used; ++i)
+			*out++ = lanes[i].found;
+	}
+	return out;
+}
+
+template<typename T, typename Alloc, typename Mapped>
+template<typename ForwardIt, typename KeyIt>
+size_t trie<T, Alloc, Mapped>::fill_lanes(ForwardIt& first, const ForwardIt& last, lane<KeyIt>* lanes) const
+{
+	// Starts a lane for each of the next few keys; returns how many.
+	size_t used = 0;
+	for(; used < batch_lanes && first != last; ++used, ++first)
+		lanes[used] = lane<KeyIt>{(*first).cbegin(), (*first).cend(), &root, false, false, false};
+	return used;
+}
+
+template<typename T, typename Alloc, typename Mapped>
+template<typename KeyIt, typename Step>
+void trie<T, Alloc, Mapped>::descend_lanes(lane<KeyIt>* lanes, size_t used, Step step) const
+{
+	// Takes every lane down to its key, a half step per lane per round: one
+	// turn asks for the node's child array, the next searches it and asks
+	// for the child.  By the time a lane comes round again, the others have
+	// given its loads time to arrive, where a loop of find()s would wait
+	// on each in turn.  step(i, n, slot) is called for each child lane i takes.
+	size_t running = used;
+	while(running > 0) {
+		for(size_t i = 0; i < used; ++i) {
+			lane<KeyIt>& l = lanes[i];
+			if(l.done)
+				continue;
+			if(!l.asked) {
+				if(l.at == l.end || l.n == nullptr) {
+					// Out of symbols, or past a nullptr child with symbols to spare
+					l.found = l.at == l.end && (l.n == nullptr || l.n->is_leaf);
+					l.done = true;
+					--running;
+					continue;
 				}
+				l.n->children.prefetch();
+				l.asked = true;
+				continue;
+			}
+			auto slot = l.n->children.find(*l.at);
+			if(slot == child_map_type::npos) {
+				l.done = true;
+				--running;
+				continue;
 			}
+			step(i, l.n, slot);
+			l.n = l.n->children.child(slot);
+			++l.at;
+			l.asked = false;
+			if(l.n != nullptr)
+				__builtin_prefetch(l.n);
 		}
+	}
+}
+
+template<typename T, typename Alloc, typename Mapped>
+auto trie<T, Alloc, Mapped>::find_node(const key_type& key) const -> const node*
+{
+	// Like contains(), but returns the node holding key.  Keys that end on a
+	// nullptr child have none, so this is only useful to a trie_map.
+	const node* currentNode{&root};
+
+	for(auto inputIt = key.cbegin(); inputIt != key.cend() && currentNode != nullptr; ++inputIt) {
+		auto index = currentNode->children.find(*inputIt);
+		if(index == child_map_type::npos)
+			return nullptr;
+		currentNode = currentNode->children.child(index);
+	}
+	return currentNode != nullptr && currentNode->is_leaf ? currentNode : nullptr;
+}
+
+template<typename T, typename Alloc, typename Mapped>
+auto trie<T, Alloc, Mapped>::equal_prefix_range(const key_type& prefix) const -> std::pair<const_iterator,const_iterator>
+{
+	// Every key starting with prefix is under the child the prefix ends on.
+	if(prefix.empty())
+		return {cbegin(), cend()};
+
+	iterator first{typename iterator::path_type{}, false};
+	const node* subtree;
+	if(!descend(prefix, first, subtree))
+		return {cend(), cend()};
+
+	// Moving past the child leaves its whole subtree behind.
+	iterator last{first};
+	++last;
+	if(subtree != nullptr) {
+		first.parents.push({subtree, subtree->is_leaf ? iterator::npos : subtree->children.first()});
+		first.fall_down();
+	}
+	return {std::move(first), std::move(last)};
+}
+
+template<typename T, typename Alloc, typename Mapped>
+auto trie<T, Alloc, Mapped>::count_prefix(const key_type& prefix) const -> size_type
+{
+	// The count of the subtree the prefix leads to.
+	const node* currentNode{&root};
+
+	for(auto inputIt = prefix.cbegin(); inputIt != prefix.cend(); ++inputIt) {
+		if(currentNode == nullptr)
+			return 0;
+		auto index = currentNode->children.find(*inputIt);
+		if(index == child_map_type::npos)
+			return 0;
+		currentNode = currentNode->children.child(index);
+	}
+	return count_of(currentNode);
+}
+
+template<typename T, typename Alloc, typename Mapped>
+template<typename ForwardIt>
+auto trie<T, Alloc, Mapped>::longest_prefix_of(ForwardIt first, ForwardIt last) const -> const_iterator
+{
+	// One descent along the input, remembering the last node passed that
+	// holds a key; the path is cut back to it at the end.
+	iterator it{typename iterator::path_type{}, false};
+	const node* currentNode{&root};
+	const node* matched = root.is_leaf ? &root : nullptr;
+	size_type depth = 0;
+
+	for(auto inputIt = first; inputIt != last; ++inputIt) {
+		auto index = currentNode->children.find(*inputIt);
+		if(index == child_map_type::npos)
+			break;
+		it.parents.push({currentNode, index});
+		currentNode = currentNode->children.child(index);
+		if(currentNode == nullptr)
+			// A nullptr child ends a key, and nothing goes on past it.
+			return it;
+		if(currentNode->is_leaf) {
+			matched = currentNode;
+			depth = it.parents.size();
+		}
+	}
+
+	if(matched == nullptr)
+		return cend();
+	while(it.parents.size() > depth)
+		it.parents.pop();
+	it.parents.push({matched, iterator::npos});
 	return it;
 }
 
-template<typename T>
-auto trie<T>::count(const key_type& key) const -> size_type
+template<typename T, typename Alloc, typename Mapped>
+template<typename ForwardIt, typename F>
+void trie<T, Alloc, Mapped>::prefixes_of(ForwardIt first, ForwardIt last, F f) const
+{
+	const node* currentNode{&root};
+	size_type length = 0;
+	if(root.is_leaf)
+		f(length);
+
+	for(auto inputIt = first; inputIt != last; ++inputIt) {
+		auto index = currentNode->children.find(*inputIt);
+		if(index == child_map_type::npos)
+			return;
+		currentNode = currentNode->children.child(index);
+		++length;
+		if(currentNode == nullptr) {
+			f(length);
+			return;
+		}
+		if(currentNode->is_leaf)
+			f(length);
+	}
+}
+
+template<typename T, typename Alloc, typename Mapped>
+template<typename F>
+void trie<T, Alloc, Mapped>::for_each(F f) const
+{
+	key_type key;
+	visit(root, key, f);
+}
+
+template<typename T, typename Alloc, typename Mapped>
+template<typename F>
+void trie<T, Alloc, Mapped>::for_each_prefix(const key_type& prefix, F f) const
+{
+	const node* currentNode{&root};
+	for(auto inputIt = prefix.cbegin(); inputIt != prefix.cend(); ++inputIt) {
+		if(currentNode == nullptr)
+			return;
+		auto index = currentNode->children.find(*inputIt);
+		if(index == child_map_type::npos)
+			return;
+		currentNode = currentNode->children.child(index);
+	}
+
+	key_type key(prefix);
+	if(currentNode == nullptr)
+		f(static_cast<const key_type&>(key));
+	else
+		visit(*currentNode, key, f);
+}
+
+template<typename T, typename Alloc, typename Mapped>
+template<typename F>
+void trie<T, Alloc, Mapped>::parallel_for_each(F f, unsigned threads) const
+{
+	if(threads == 0)
+		threads = std::thread::hardware_concurrency();
+	if(threads > root.children.size())
+		threads = root.children.size();
+	if(threads <= 1) {
+		for_each(f);
+		return;
+	}
+
+	if(root.is_leaf)
+		f(key_type{});
+	// The biggest subtrees go first, so no thread is left with a big one at the end.
+	std::vector<typename child_map_type::size_type> slots;
+	for(auto slot = root.children.first(); slot != root.children.end_slot(); slot = root.children.next(slot))
+		slots.push_back(slot);
+	std::stable_sort(slots.begin(), slots.end(), [this](typename child_map_type::size_type a, typename child_map_type::size_type b) {
+		return count_of(root.children.child(a)) > count_of(root.children.child(b));
+	});
+
+	std::atomic<size_t> next{0};
+	std::exception_ptr error;
+	std::mutex error_lock;
+	auto work = [&]() {
+		key_type key;
+		for(;;) {
+			size_t i = next++;
+			if(i >= slots.size())
+				return;
+			try {
+				key.assign(1, root.children.symbol(slots[i]));
+				const node* child = root.children.child(slots[i]);
+				if(child == nullptr)
+					f(static_cast<const key_type&>(key));
+				else
+					visit(*child, key, f);
+			}
+			catch(...) {
+				// Hand out no more work, and report the first failure.
+				next = slots.size();
+				std::lock_guard<std::mutex> lock(error_lock);
+				if(!error)
+					error = std::current_exception();
+				return;
+			}
+		}
+	};
+	std::vector<std::thread> pool;
+	try {
+		for(unsigned i = 1; i < threads; ++i)
+			pool.emplace_back(work);
+	}
+	catch(...) {
+		// Fewer threads will do.
+	}
+	work();
+	for(auto& t: pool)
+		t.join();
+	if(error)
+		std::rethrow_exception(error);
+}
+
+template<typename T, typename Alloc, typename Mapped>
+template<typename F>
+void trie<T, Alloc, Mapped>::visit(const node& n, key_type& key, F& f)
+{
+	// key is the path to n; it is put back the way it was before returning.
+	if(n.is_leaf)
+		f(static_cast<const key_type&>(key));
+	for(auto slot = n.children.first(); slot != n.children.end_slot(); slot = n.children.next(slot)) {
+		const node* child = n.children.child(slot);
+		auto sibling = n.children.next(slot);
+		if(sibling != n.children.end_slot())
+			__builtin_prefetch(n.children.child(sibling));
+		key.push_back(n.children.symbol(slot));
+		if(child == nullptr)
+			f(static_cast<const key_type&>(key));
+		else
+			visit(*child, key, f);
+		key.pop_back();
+	}
+}
+
+// The state of one fuzzy_find() walk
+template<typename T, typename Alloc, typename Mapped>
+struct trie<T, Alloc, Mapped>::fuzzy_search {
+	std::vector<symbol> target;
+	size_type max_distance;
+	bool transpositions;
+	// One row of the edit distance table per depth of the walk: the entry
+	// for depth d, column j is the distance from the d symbols of the path to
+	// the first j symbols of the target.
+	std::vector<size_type> rows;
+	std::vector<std::pair<key_type,size_type>> matches;
+
+	size_type width() const { return target.size() + 1; }
+	// Fills in the row for key, whose last symbol is new; prior is the
+	// symbol before it, if any.  Returns the smallest entry.
+	size_type step(const key_type& key, const symbol* prior);
+};
+
+template<typename T, typename Alloc, typename Mapped>
+auto trie<T, Alloc, Mapped>::fuzzy_search::step(const key_type& key, const symbol* prior) -> size_type
+{
+	size_type depth = key.size();
+	if(rows.size() < (depth + 1) * width())
+		rows.resize((depth + 1) * width());
+	const size_type* above = &rows[(depth - 1) * width()];
+	size_type* row = &rows[depth * width()];
+	const symbol& s = key.back();
+
+	row[0] = depth;
+	size_type least = row[0];
+	for(size_type j = 1; j < width(); ++j) {
+		row[j] = std::min({above[j] + 1, row[j - 1] + 1, above[j - 1] + (target[j - 1] == s ? 0 : 1)});
+		if(transpositions && prior != nullptr && j > 1 && target[j - 1] == *prior && target[j - 2] == s)
+			row[j] = std::min(row[j], rows[(depth - 2) * width() + j - 2] + 1);
+		least = std::min(least, row[j]);
+	}
+	return least;
+}
+
+template<typename T, typename Alloc, typename Mapped>
+auto trie<T, Alloc, Mapped>::fuzzy_find(const key_type& key, size_type max_distance, bool transpositions) const -> std::vector<std::pair<key_type,size_type>>
+{
+	fuzzy_search search{{key.cbegin(), key.cend()}, max_distance, transpositions, {}, {}};
+	search.rows.resize(search.width());
+	for(size_type j = 0; j < search.width(); ++j)
+		search.rows[j] = j;
+
+	key_type path;
+	if(root.is_leaf && search.target.size() <= max_distance)
+		search.matches.emplace_back(path, search.target.size());
+	fuzzy_visit(root, path, nullptr, search);
+	return std::move(search.matches);
+}
+
+template<typename T, typename Alloc, typename Mapped>
+void trie<T, Alloc, Mapped>::fuzzy_visit(const node& n, key_type& key, const symbol* prior, fuzzy_search& search)
 {
-	return find(key) == cend() ? 0 : 1;
+	// key is the path to n, and its row is filled in.  A child whose row has
+	// nothing within max_distance can't lead to a match: every entry below
+	// it is at least as big.
+	for(auto slot = n.children.first(); slot != n.children.end_slot(); slot = n.children.next(slot)) {
+		const node* child = n.children.child(slot);
+		key.push_back(n.children.symbol(slot));
+		size_type least = search.step(key, prior);
+		if(least <= search.max_distance) {
+			size_type distance = search.rows[key.size() * search.width() + search.width() - 1];
+			if((child == nullptr || child->is_leaf) && distance <= search.max_distance)
+				search.matches.emplace_back(key, distance);
+			if(child != nullptr) {
+				symbol last = key.back();
+				fuzzy_visit(*child, key, &last, search);
+			}
+		}
+		key.pop_back();
+	}
 }
 
-template<typename T>
-constexpr auto trie<T>::max_size() const -> size_type
+template<typename T, typename Alloc, typename Mapped>
+auto trie<T, Alloc, Mapped>::nth(size_type k) const -> const_iterator
+{
+	// Skip whole subtrees by their counts until the one holding the k-th key.
+	if(k >= size())
+		return cend();
+
+	iterator it{typename iterator::path_type{}, false};
+	const node* currentNode{&root};
+	for(;;) {
+		if(currentNode->is_leaf) {
+			if(k == 0) {
+				it.parents.push({currentNode, iterator::npos});
+				return it;
+			}
+			--k;
+		}
+		auto slot = currentNode->children.first();
+		while(k >= count_of(currentNode->children.child(slot))) {
+			k -= count_of(currentNode->children.child(slot));
+			slot = currentNode->children.next(slot);
+		}
+		it.parents.push({currentNode, slot});
+		currentNode = currentNode->children.child(slot);
+		if(currentNode == nullptr)
+			return it;
+	}
+}
+
+template<typename T, typename Alloc, typename Mapped>
+auto trie<T, Alloc, Mapped>::rank(const key_type& key) const -> size_type
+{
+	// The number of keys that sort before key, whether or not key is present.
+	size_type r = 0;
+	const node* currentNode{&root};
+
+	for(auto inputIt = key.cbegin(); inputIt != key.cend(); ++inputIt) {
+		if(currentNode->is_leaf)
+			// The node's own key is a proper prefix of key.
+			++r;
+		auto slot = currentNode->children.first();
+		for(; slot != currentNode->children.end_slot() && currentNode->children.symbol(slot) < *inputIt;
+		      slot = currentNode->children.next(slot))
+			r += count_of(currentNode->children.child(slot));
+		if(slot == currentNode->children.end_slot() || *inputIt < currentNode->children.symbol(slot))
+			return r;
+		const node* child = currentNode->children.child(slot);
+		if(child == nullptr)
+			// A shorter key ends here, and sorts before key unless they are equal.
+			return inputIt + 1 == key.cend() ? r : r + 1;
+		currentNode = child;
+	}
+	// Everything below this node sorts after key.
+	return r;
+}
+
+template<typename T, typename Alloc, typename Mapped>
+constexpr auto trie<T, Alloc, Mapped>::max_size() const -> size_type
 {
 	// We have a depth limited only by the size of the iterator stack,
 	// and a width limited by the size of the size of the vector.
@@ -369,11 +1577,35 @@ constexpr auto trie<T>::max_size() const -> size_type
 	return std::numeric_limits< size_type >::max();
 }
 
-template<typename T>
-void trie<T>::swap(trie<T>& other)
+template<typename T, typename Alloc, typename Mapped>
+void trie<T, Alloc, Mapped>::swap(trie<T, Alloc, Mapped>& other)
+{
+	swap_roots(root, other.root);
+	alloc.swap(other.alloc);
+}
+
+template<typename T, typename Alloc, typename Mapped>
+void trie<T, Alloc, Mapped>::write_image(std::ostream& out) const
 {
-	std::swap(children, other.children);
-	std::swap(is_leaf, other.is_leaf);
+	static_assert(!stores_values, "trie images don't hold values");
+	trie_image_writer<typename T::value_type> writer{out};
+	writer.finish(write_image(writer, root));
+}
+
+template<typename T, typename Alloc, typename Mapped>
+uint64_t trie<T, Alloc, Mapped>::write_image(trie_image_writer<typename T::value_type>& writer, const node& n) const
+{
+	// Children go first, so their offsets are known when n is written.
+	std::vector<typename T::value_type> symbols;
+	std::vector<uint64_t> children;
+	symbols.reserve(n.children.size());
+	children.reserve(n.children.size());
+	for(auto slot = n.children.first(); slot != n.children.end_slot(); slot = n.children.next(slot)) {
+		symbols.push_back(n.children.symbol(slot));
+		const node* child = n.children.child(slot);
+		children.push_back(child == nullptr ? 0 : write_image(writer, *child));
+	}
+	return writer.node(n.count, n.is_leaf, symbols, children);
 }
 
 #endif
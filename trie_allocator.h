@@ -0,0 +1,242 @@
+// trie_allocator.h - Node allocation policies for trie<T>
+// Copyright (C) 2013  George Hilliard
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef TRIE_ALLOCATOR_H
+#define TRIE_ALLOCATOR_H
+
+#include <cstddef>
+#include <new>
+#include <utility>
+#include <algorithm>
+
+// A trie allocation policy hands out raw memory for nodes and child arrays.
+// Each trie owns one policy object, and every node in that trie comes from it.
+// A policy provides:
+//
+//   void* allocate(std::size_t);
+//   void deallocate(void*, std::size_t);  Size is the one passed to allocate().
+//   void release();                       Frees everything ever allocated.
+//   void swap(Policy&);
+//   void adopt(Policy&);                  Takes over everything the other has
+//                                         allocated, leaving it empty.
+//   static constexpr bool bulk_release;   If true, release() alone reclaims all
+//                                         memory and deallocate() may be skipped.
+//   static constexpr std::size_t alignment;
+//
+// Copying a policy gives a new, empty one with the same settings; the memory
+// it manages belongs to exactly one trie.  Moving a policy moves the memory.
+
+// Plain operator new and delete; the trie frees its nodes one by one.
+class trie_heap_allocator {
+public:
+	static constexpr bool bulk_release = false;
+	static constexpr std::size_t alignment = alignof(std::max_align_t);
+
+	void* allocate(std::size_t n) { return ::operator new(n); }
+	void deallocate(void* p, std::size_t) { ::operator delete(p); }
+	void release() {}
+	void swap(trie_heap_allocator&) {}
+	void adopt(trie_heap_allocator&) {}
+};
+
+// Bump allocator.  Memory is carved sequentially out of large blocks and is
+// never given back individually, so erase() does not shrink the footprint.
+// Destroying or clearing the trie frees the blocks without visiting any node.
+class trie_arena_allocator {
+	struct block {
+		block* next;
+	};
+
+	block* blocks = nullptr;
+	char* cursor = nullptr;
+	char* limit = nullptr;
+	std::size_t first_block_size;
+	std::size_t next_block_size;
+
+	static constexpr std::size_t max_block_size = 1 << 20;
+	static constexpr std::size_t header_size = (sizeof(block) + alignof(std::max_align_t) - 1) & ~(alignof(std::max_align_t) - 1);
+
+public:
+	static constexpr bool bulk_release = true;
+	static constexpr std::size_t alignment = alignof(void*);
+
+	explicit trie_arena_allocator(std::size_t block_size = 64 * 1024) :
+		first_block_size{block_size}, next_block_size{block_size}
+	{}
+	trie_arena_allocator(const trie_arena_allocator& other) :
+		first_block_size{other.first_block_size}, next_block_size{other.first_block_size}
+	{}
+	trie_arena_allocator(trie_arena_allocator&& other) :
+		first_block_size{other.first_block_size}, next_block_size{other.first_block_size}
+	{
+		swap(other);
+	}
+	trie_arena_allocator& operator=(trie_arena_allocator other) {
+		swap(other);
+		return *this;
+	}
+	~trie_arena_allocator() { release(); }
+
+	void* allocate(std::size_t n) {
+		n = (n + alignment - 1) & ~(alignment - 1);
+		if(static_cast<std::size_t>(limit - cursor) < n)
+			grow(n);
+		void* p = cursor;
+		cursor += n;
+		return p;
+	}
+	void deallocate(void*, std::size_t) {}
+
+	void release() {
+		while(blocks != nullptr) {
+			block* next = blocks->next;
+			::operator delete(blocks);
+			blocks = next;
+		}
+		cursor = limit = nullptr;
+		next_block_size = first_block_size;
+	}
+
+	void adopt(trie_arena_allocator& other) {
+		if(other.blocks == nullptr)
+			return;
+		if(blocks == nullptr)
+			swap(other);
+		else {
+			// Keep allocating from our own current block; the other's blocks
+			// go behind it, only to be released.
+			block* tail = other.blocks;
+			while(tail->next != nullptr)
+				tail = tail->next;
+			tail->next = blocks->next;
+			blocks->next = other.blocks;
+		}
+		other.blocks = nullptr;
+		other.cursor = other.limit = nullptr;
+		other.next_block_size = other.first_block_size;
+	}
+
+	void swap(trie_arena_allocator& other) {
+		std::swap(blocks, other.blocks);
+		std::swap(cursor, other.cursor);
+		std::swap(limit, other.limit);
+		std::swap(first_block_size, other.first_block_size);
+		std::swap(next_block_size, other.next_block_size);
+	}
+
+private:
+	void grow(std::size_t n) {
+		// Blocks double in size, so a big trie needs only a handful of them.
+		std::size_t size = next_block_size < n ? n : next_block_size;
+		block* b = static_cast<block*>(::operator new(header_size + size));
+		b->next = blocks;
+		blocks = b;
+		cursor = reinterpret_cast<char*>(b) + header_size;
+		limit = cursor + size;
+		next_block_size = next_block_size * 2 < max_block_size ? next_block_size * 2 : max_block_size;
+	}
+};
+
+// Size-class pool.  Fresh memory comes from an arena; freed chunks go on a
+// free list for their size class and are handed out again before the arena
+// is touched.  Like the arena, everything is freed at once by release().
+class trie_pool_allocator {
+	struct free_chunk {
+		free_chunk* next;
+	};
+
+	// Classes are 8 bytes apart up to 128 bytes, then powers of two.
+	static constexpr std::size_t linear_classes = 16;
+	static constexpr std::size_t num_classes = linear_classes + sizeof(std::size_t) * 8;
+
+	trie_arena_allocator arena;
+	free_chunk* free_lists[num_classes];
+
+	static std::size_t size_class(std::size_t n) {
+		if(n <= linear_classes * 8)
+			return n == 0 ? 0 : (n - 1) / 8;
+		std::size_t c = linear_classes;
+		for(std::size_t size = linear_classes * 16; size < n; size *= 2)
+			++c;
+		return c;
+	}
+	static std::size_t class_size(std::size_t c) {
+		return c < linear_classes ? (c + 1) * 8 : (linear_classes * 16) << (c - linear_classes);
+	}
+
+public:
+	static constexpr bool bulk_release = true;
+	static constexpr std::size_t alignment = trie_arena_allocator::alignment;
+
+	explicit trie_pool_allocator(std::size_t block_size = 64 * 1024) :
+		arena{block_size}
+	{
+		std::fill(free_lists, free_lists + num_classes, nullptr);
+	}
+	trie_pool_allocator(const trie_pool_allocator& other) :
+		arena{other.arena}
+	{
+		std::fill(free_lists, free_lists + num_classes, nullptr);
+	}
+	trie_pool_allocator(trie_pool_allocator&& other) :
+		arena{std::move(other.arena)}
+	{
+		std::copy(other.free_lists, other.free_lists + num_classes, free_lists);
+		std::fill(other.free_lists, other.free_lists + num_classes, nullptr);
+	}
+	trie_pool_allocator& operator=(trie_pool_allocator other) {
+		swap(other);
+		return *this;
+	}
+
+	void* allocate(std::size_t n) {
+		std::size_t c = size_class(n);
+		if(free_chunk* chunk = free_lists[c]) {
+			free_lists[c] = chunk->next;
+			return chunk;
+		}
+		return arena.allocate(class_size(c));
+	}
+	void deallocate(void* p, std::size_t n) {
+		std::size_t c = size_class(n);
+		free_chunk* chunk = static_cast<free_chunk*>(p);
+		chunk->next = free_lists[c];
+		free_lists[c] = chunk;
+	}
+
+	void release() {
+		arena.release();
+		std::fill(free_lists, free_lists + num_classes, nullptr);
+	}
+
+	void adopt(trie_pool_allocator& other) {
+		arena.adopt(other.arena);
+		for(std::size_t c = 0; c < num_classes; ++c) {
+			while(free_chunk* chunk = other.free_lists[c]) {
+				other.free_lists[c] = chunk->next;
+				chunk->next = free_lists[c];
+				free_lists[c] = chunk;
+			}
+		}
+	}
+
+	void swap(trie_pool_allocator& other) {
+		arena.swap(other.arena);
+		std::swap_ranges(free_lists, free_lists + num_classes, other.free_lists);
+	}
+};
+
+#endif
@@ -0,0 +1,148 @@
+// trie_bit_vector.h - A bit vector with rank and select
+// Copyright (C) 2013  George Hilliard
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef TRIE_BIT_VECTOR_H
+#define TRIE_BIT_VECTOR_H
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <algorithm>
+
+// An append-only bit vector.  Once finish() is called, rank1() counts the
+// ones before a position and select0() finds the position of a given zero.
+// The directories add 12.5% for rank and a little more for select.
+class trie_bit_vector {
+	static constexpr std::size_t block_bits = 512;
+	static constexpr std::size_t block_words = block_bits / 64;
+	// Every sample_rate'th zero records its block, to narrow select0's search.
+	static constexpr std::size_t sample_rate = 512;
+
+	std::vector<uint64_t> words;
+	std::vector<uint64_t> ones_before;  // per block
+	std::vector<uint32_t> zero_samples;
+	std::size_t bits = 0;
+
+	std::size_t zeros_before(std::size_t block) const { return block * block_bits - ones_before[block]; }
+
+	// Position of set bit number k (from 0) in w
+	static unsigned select_in_word(uint64_t w, std::size_t k) {
+		for(; k > 0; --k)
+			w &= w - 1;
+		return __builtin_ctzll(w);
+	}
+
+public:
+	void push_back(bool bit) {
+		if(bits % 64 == 0)
+			words.push_back(0);
+		if(bit)
+			words.back() |= uint64_t(1) << (bits % 64);
+		++bits;
+	}
+	void finish();
+
+	std::size_t size() const { return bits; }
+	bool operator[](std::size_t i) const { return words[i / 64] >> (i % 64) & 1; }
+
+	// Ones in [0, i)
+	std::size_t rank1(std::size_t i) const;
+	// Position of zero number k, counting from 0
+	std::size_t select0(std::size_t k) const;
+	// The first zero at or after i, or size()
+	std::size_t next_zero(std::size_t i) const;
+
+	std::size_t allocated_bytes() const {
+		return words.capacity() * sizeof(uint64_t) + ones_before.capacity() * sizeof(uint64_t) +
+		       zero_samples.capacity() * sizeof(uint32_t);
+	}
+};
+
+inline void trie_bit_vector::finish()
+{
+	// One extra block, so every block has an end for select0's search.
+	std::size_t blocks = (words.size() + block_words - 1) / block_words + 1;
+	words.resize((blocks - 1) * block_words, 0);
+	ones_before.assign(blocks, 0);
+	zero_samples.clear();
+
+	std::size_t ones = 0, zeros = 0;
+	for(std::size_t b = 0; b + 1 < blocks; ++b) {
+		ones_before[b] = ones;
+		for(std::size_t w = b * block_words; w < (b + 1) * block_words; ++w) {
+			std::size_t set = __builtin_popcountll(words[w]);
+			std::size_t valid = bits > w * 64 ? std::min<std::size_t>(64, bits - w * 64) : 0;
+			// Zeros [zeros, end) are in this block.
+			std::size_t end = zeros + valid - set;
+			while(zero_samples.size() * sample_rate < end)
+				zero_samples.push_back(b);
+			zeros = end;
+			ones += set;
+		}
+	}
+	ones_before[blocks - 1] = ones;
+	words.shrink_to_fit();
+	zero_samples.shrink_to_fit();
+}
+
+inline std::size_t trie_bit_vector::rank1(std::size_t i) const
+{
+	std::size_t b = i / block_bits;
+	std::size_t r = ones_before[b];
+	for(std::size_t w = b * block_words; w < i / 64; ++w)
+		r += __builtin_popcountll(words[w]);
+	if(i % 64 != 0)
+		r += __builtin_popcountll(words[i / 64] & ((uint64_t(1) << (i % 64)) - 1));
+	return r;
+}
+
+inline std::size_t trie_bit_vector::select0(std::size_t k) const
+{
+	// The zero is in the last block with no more than k zeros before it,
+	// which lies between the samples around k.
+	std::size_t s = k / sample_rate;
+	std::size_t lo = zero_samples[s];
+	std::size_t hi = s + 1 < zero_samples.size() ? zero_samples[s + 1] + 1 : ones_before.size() - 1;
+	while(hi - lo > 1) {
+		std::size_t mid = lo + (hi - lo) / 2;
+		if(zeros_before(mid) <= k)
+			lo = mid;
+		else
+			hi = mid;
+	}
+
+	k -= zeros_before(lo);
+	for(std::size_t w = lo * block_words; ; ++w) {
+		std::size_t zeros = 64 - __builtin_popcountll(words[w]);
+		if(k < zeros)
+			return w * 64 + select_in_word(~words[w], k);
+		k -= zeros;
+	}
+}
+
+inline std::size_t trie_bit_vector::next_zero(std::size_t i) const
+{
+	for(std::size_t w = i / 64; w < words.size(); ++w) {
+		uint64_t zeros = ~words[w];
+		if(w == i / 64)
+			zeros &= ~uint64_t(0) << (i % 64);
+		if(zeros != 0)
+			return std::min<std::size_t>(bits, w * 64 + __builtin_ctzll(zeros));
+	}
+	return bits;
+}
+
+#endif
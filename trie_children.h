@@ -0,0 +1,408 @@
+// trie_children.h - Child arrays for trie<T> nodes
+// Copyright (C) 2013  George Hilliard
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef TRIE_CHILDREN_H
+#define TRIE_CHILDREN_H
+
+#include <cstdint>
+#include <cstddef>
+#include <new>
+#include <utility>
+#include <algorithm>
+#include <type_traits>
+
+#include "trie_simd.h"
+
+// Both child array types below map symbols to Node pointers, in symbol order.
+// Their storage comes from the trie's allocation policy, which the trie passes
+// in to anything that allocates, so each array is just a pointer and two
+// counts.  They do not own the children they point to; a nullptr child is
+// a valid entry.
+//
+// Children are addressed by slot.  Walk them in order with first(), next()
+// and end_slot(), or backwards with last() and prev().  Slots are stable
+// until the next emplace() or erase().
+
+// The children of a node, sorted by symbol.  The symbols are packed together
+// in one array and the child pointers follow in a second one, so a search
+// only touches the symbols, several of them per cache line (or per vector
+// compare, see trie_simd.h).  Both arrays share a single allocation.
+// A slot is simply the index into these arrays.
+template<typename S, typename Node, typename Alloc>
+class trie_sorted_children {
+public:
+	typedef S symbol_type;
+	typedef trie_symbol_search<symbol_type> search;
+	typedef typename search::size_type size_type;
+	static constexpr size_type npos = search::npos;
+
+	trie_sorted_children() =default;
+	trie_sorted_children(const trie_sorted_children&) =delete;
+	trie_sorted_children& operator=(const trie_sorted_children&) =delete;
+
+	size_type size() const { return count; }
+	bool empty() const { return count == 0; }
+
+	size_type first() const { return 0; }
+	size_type last() const { return count - 1; }
+	size_type next(size_type slot) const { return slot + 1; }
+	size_type prev(size_type slot) const { return slot - 1; }
+	size_type end_slot() const { return count; }
+
+	const symbol_type& symbol(size_type slot) const { return keys[slot]; }
+	Node*& child(size_type slot) { return children()[slot]; }
+	Node* child(size_type slot) const { return children()[slot]; }
+
+	// Slot of symbol, or npos
+	size_type find(const symbol_type& s) const { return search::find(keys, count, s); }
+	// Slot to pass to emplace() for a symbol that isn't present
+	size_type lower_bound(const symbol_type& s) const { return search::lower_bound(keys, count, s); }
+	// Starts loading what find() will read
+	void prefetch() const {
+		if(keys != nullptr) {
+			__builtin_prefetch(keys);
+			__builtin_prefetch(children());
+		}
+	}
+
+	void reserve(Alloc&, size_type);
+	// Inserts at the slot from lower_bound(), or at end_slot() when symbols
+	// are added in order.  Returns the new child's slot.
+	size_type emplace(Alloc&, size_type, const symbol_type&, Node*);
+	void erase(Alloc&, size_type);
+	void clear(Alloc&);
+	void forget() { keys = nullptr; count = capacity = 0; }
+	std::size_t allocated_bytes() const { return keys == nullptr ? 0 : bytes(capacity); }
+	void swap(trie_sorted_children& other) {
+		std::swap(keys, other.keys);
+		std::swap(count, other.count);
+		std::swap(capacity, other.capacity);
+	}
+
+protected:
+	symbol_type* keys = nullptr;
+	size_type count = 0;
+	size_type capacity = 0;
+
+	// The pointer array starts after the (padded) symbols, suitably aligned.
+	static std::size_t keys_bytes(size_type capacity) {
+		return (search::padded(capacity) * sizeof(symbol_type) + alignof(Node*) - 1) & ~(alignof(Node*) - 1);
+	}
+	static std::size_t bytes(size_type capacity) {
+		return keys_bytes(capacity) + capacity * sizeof(Node*);
+	}
+	Node** children() const {
+		return reinterpret_cast<Node**>(reinterpret_cast<char*>(keys) + keys_bytes(capacity));
+	}
+};
+
+template<typename S, typename Node, typename Alloc>
+constexpr typename trie_sorted_children<S, Node, Alloc>::size_type trie_sorted_children<S, Node, Alloc>::npos;
+
+template<typename S, typename Node, typename Alloc>
+void trie_sorted_children<S, Node, Alloc>::reserve(Alloc& alloc, size_type n)
+{
+	if(n <= capacity)
+		return;
+
+	symbol_type* fresh = static_cast<symbol_type*>(alloc.allocate(bytes(n)));
+	Node** fresh_children = reinterpret_cast<Node**>(reinterpret_cast<char*>(fresh) + keys_bytes(n));
+	for(size_type i = 0; i < count; ++i) {
+		new(fresh + i) symbol_type(std::move(keys[i]));
+		keys[i].~symbol_type();
+	}
+	std::copy(children(), children() + count, fresh_children);
+	if(keys != nullptr)
+		alloc.deallocate(keys, bytes(capacity));
+	keys = fresh;
+	capacity = n;
+}
+
+template<typename S, typename Node, typename Alloc>
+auto trie_sorted_children<S, Node, Alloc>::emplace(Alloc& alloc, size_type slot, const symbol_type& s, Node* c) -> size_type
+{
+	if(count == capacity)
+		// Most nodes have very few children, so start small.
+		reserve(alloc, capacity == 0 ? 1 : capacity * 2);
+
+	if(slot == count)
+		new(keys + count) symbol_type(s);
+	else {
+		new(keys + count) symbol_type(std::move(keys[count - 1]));
+		std::move_backward(keys + slot, keys + count - 1, keys + count);
+		keys[slot] = s;
+		std::copy_backward(children() + slot, children() + count, children() + count + 1);
+	}
+	children()[slot] = c;
+	++count;
+	return slot;
+}
+
+template<typename S, typename Node, typename Alloc>
+void trie_sorted_children<S, Node, Alloc>::erase(Alloc&, size_type slot)
+{
+	std::move(keys + slot + 1, keys + count, keys + slot);
+	std::copy(children() + slot + 1, children() + count, children() + slot);
+	keys[--count].~symbol_type();
+}
+
+template<typename S, typename Node, typename Alloc>
+void trie_sorted_children<S, Node, Alloc>::clear(Alloc& alloc)
+{
+	for(size_type i = 0; i < count; ++i)
+		keys[i].~symbol_type();
+	if(keys != nullptr)
+		alloc.deallocate(keys, bytes(capacity));
+	forget();
+}
+
+// Children for byte-sized symbols, in the style of the Adaptive Radix Tree.
+// The layout follows the fanout: up to 16 children are a sorted array as
+// above, up to 48 are a 256-entry table of positions into 48 child
+// pointers, and beyond that there is a child pointer for every byte value.
+// The two big kinds find a child in O(1) and use the symbol's rank (its
+// position among all 256 byte values) as its slot.  A bitmap records which
+// ranks are present, since a nullptr child is a valid entry.
+template<typename S, typename Node, typename Alloc>
+class trie_adaptive_children : public trie_sorted_children<S, Node, Alloc> {
+	typedef trie_sorted_children<S, Node, Alloc> sorted;
+
+public:
+	typedef typename sorted::symbol_type symbol_type;
+	typedef typename sorted::size_type size_type;
+	using sorted::npos;
+
+	size_type first() const { return big() ? next_set(0) : 0; }
+	size_type last() const { return prev(end_slot()); }
+	size_type next(size_type slot) const { return big() ? next_set(slot + 1) : slot + 1; }
+	size_type prev(size_type slot) const { return big() ? prev_set(slot) : slot - 1; }
+	size_type end_slot() const { return big() ? ranks : this->count; }
+
+	symbol_type symbol(size_type slot) const { return big() ? unrank(slot) : this->keys[slot]; }
+	Node*& child(size_type slot) {
+		if(!big())
+			return sorted::child(slot);
+		return this->capacity == 48 ? as48()->children[as48()->position[slot]] : as256()->children[slot];
+	}
+	Node* child(size_type slot) const { return const_cast<trie_adaptive_children*>(this)->child(slot); }
+
+	size_type find(const symbol_type& s) const {
+		if(!big())
+			return sorted::find(s);
+		size_type r = rank(s);
+		return test(bits(), r) ? r : npos;
+	}
+	size_type lower_bound(const symbol_type& s) const { return big() ? rank(s) : sorted::lower_bound(s); }
+	void prefetch() const {
+		if(big())
+			__builtin_prefetch(bits());
+		else
+			sorted::prefetch();
+	}
+
+	void reserve(Alloc&, size_type);
+	size_type emplace(Alloc&, size_type, const symbol_type&, Node*);
+	void erase(Alloc&, size_type);
+	void clear(Alloc&);
+	std::size_t allocated_bytes() const { return big() ? big_bytes(this->capacity) : sorted::allocated_bytes(); }
+
+private:
+	static constexpr size_type max_sorted = 16;
+	static constexpr size_type ranks = 256;
+	// Shrink only well below the size we grew at, so a node hovering around
+	// a boundary doesn't flip back and forth.
+	static constexpr size_type shrink_to_sorted = 12;
+	static constexpr size_type shrink_to_48 = 40;
+
+	struct node48 {
+		uint64_t bits[ranks / 64];
+		uint8_t position[ranks];  // rank -> index into children
+		uint8_t rank[48];         // index into children -> rank
+		Node* children[48];
+	};
+	struct node256 {
+		uint64_t bits[ranks / 64];
+		Node* children[ranks];
+	};
+
+	// Either big kind has its bitmap first.
+	bool big() const { return this->capacity > max_sorted; }
+	uint64_t* bits() const { return reinterpret_cast<uint64_t*>(this->keys); }
+	node48* as48() const { return reinterpret_cast<node48*>(this->keys); }
+	node256* as256() const { return reinterpret_cast<node256*>(this->keys); }
+	static std::size_t big_bytes(size_type capacity) { return capacity == 48 ? sizeof(node48) : sizeof(node256); }
+
+	// Ranks put the symbols in the same order as their < does.
+	static size_type rank(const symbol_type& s) {
+		return static_cast<unsigned char>(s) ^ (std::is_signed<symbol_type>::value ? 0x80 : 0);
+	}
+	static symbol_type unrank(size_type r) {
+		return static_cast<symbol_type>(static_cast<unsigned char>(r ^ (std::is_signed<symbol_type>::value ? 0x80 : 0)));
+	}
+
+	static bool test(const uint64_t* bits, size_type r) { return (bits[r / 64] >> (r % 64)) & 1; }
+	size_type next_set(size_type from) const;
+	size_type prev_set(size_type before) const;
+
+	void add(const symbol_type&, Node*);
+	void rebuild(Alloc&, size_type);
+};
+
+template<typename S, typename Node, typename Alloc>
+auto trie_adaptive_children<S, Node, Alloc>::next_set(size_type from) const -> size_type
+{
+	for(size_type w = from / 64; w < ranks / 64; ++w) {
+		uint64_t word = bits()[w];
+		if(w == from / 64)
+			word &= ~uint64_t(0) << (from % 64);
+		if(word != 0)
+			return w * 64 + __builtin_ctzll(word);
+	}
+	return ranks;
+}
+
+template<typename S, typename Node, typename Alloc>
+auto trie_adaptive_children<S, Node, Alloc>::prev_set(size_type before) const -> size_type
+{
+	// The caller guarantees there is a set bit below before.
+	size_type top = before - 1;
+	for(size_type w = top / 64 + 1; w-- > 0; ) {
+		uint64_t word = bits()[w];
+		if(w == top / 64 && top % 64 != 63)
+			word &= (uint64_t(2) << (top % 64)) - 1;
+		if(word != 0)
+			return w * 64 + 63 - __builtin_clzll(word);
+	}
+	return npos;
+}
+
+template<typename S, typename Node, typename Alloc>
+void trie_adaptive_children<S, Node, Alloc>::add(const symbol_type& s, Node* c)
+{
+	// Adds a child to a big kind, or appends one to a sorted array with room.
+	if(!big()) {
+		this->keys[this->count] = s;
+		this->children()[this->count++] = c;
+		return;
+	}
+	size_type r = rank(s);
+	bits()[r / 64] |= uint64_t(1) << (r % 64);
+	if(this->capacity == 48) {
+		as48()->position[r] = this->count;
+		as48()->rank[this->count] = r;
+		as48()->children[this->count] = c;
+	}
+	else
+		as256()->children[r] = c;
+	++this->count;
+}
+
+template<typename S, typename Node, typename Alloc>
+void trie_adaptive_children<S, Node, Alloc>::rebuild(Alloc& alloc, size_type capacity)
+{
+	// Moves every child, in order, into a fresh array of the given kind.
+	trie_adaptive_children fresh;
+	if(capacity <= max_sorted)
+		fresh.sorted::reserve(alloc, capacity);
+	else {
+		fresh.keys = static_cast<symbol_type*>(alloc.allocate(big_bytes(capacity)));
+		fresh.capacity = capacity;
+		std::fill(fresh.bits(), fresh.bits() + ranks / 64, 0);
+	}
+	for(size_type slot = first(); slot != end_slot(); slot = next(slot))
+		fresh.add(symbol(slot), child(slot));
+	clear(alloc);
+	this->swap(fresh);
+}
+
+template<typename S, typename Node, typename Alloc>
+void trie_adaptive_children<S, Node, Alloc>::reserve(Alloc& alloc, size_type n)
+{
+	if(n <= this->capacity)
+		return;
+	if(n <= max_sorted)
+		sorted::reserve(alloc, n);
+	else
+		rebuild(alloc, n <= 48 ? 48 : ranks);
+}
+
+template<typename S, typename Node, typename Alloc>
+auto trie_adaptive_children<S, Node, Alloc>::emplace(Alloc& alloc, size_type slot, const symbol_type& s, Node* c) -> size_type
+{
+	if(!big()) {
+		if(this->count < max_sorted) {
+			// Doubling stops at max_sorted: an array that was sized exactly
+			// (by a copy or a bulk build) mustn't outgrow the sorted layout.
+			if(this->count == this->capacity)
+				sorted::reserve(alloc, this->capacity == 0 ? 1 : this->capacity * 2 < max_sorted ? this->capacity * 2 : max_sorted);
+			return sorted::emplace(alloc, slot, s, c);
+		}
+		rebuild(alloc, 48);
+	}
+	else if(this->capacity == 48 && this->count == 48)
+		rebuild(alloc, ranks);
+
+	add(s, c);
+	return rank(s);
+}
+
+template<typename S, typename Node, typename Alloc>
+void trie_adaptive_children<S, Node, Alloc>::erase(Alloc& alloc, size_type slot)
+{
+	if(!big()) {
+		sorted::erase(alloc, slot);
+		return;
+	}
+
+	bits()[slot / 64] &= ~(uint64_t(1) << (slot % 64));
+	--this->count;
+	if(this->capacity == 48) {
+		// Keep the child pointers dense by moving the last one into the hole.
+		node48* n = as48();
+		uint8_t hole = n->position[slot];
+		n->children[hole] = n->children[this->count];
+		n->rank[hole] = n->rank[this->count];
+		n->position[n->rank[hole]] = hole;
+		if(this->count <= shrink_to_sorted)
+			rebuild(alloc, max_sorted);
+	}
+	else {
+		as256()->children[slot] = nullptr;
+		if(this->count <= shrink_to_48)
+			rebuild(alloc, 48);
+	}
+}
+
+template<typename S, typename Node, typename Alloc>
+void trie_adaptive_children<S, Node, Alloc>::clear(Alloc& alloc)
+{
+	if(!big()) {
+		sorted::clear(alloc);
+		return;
+	}
+	alloc.deallocate(this->keys, big_bytes(this->capacity));
+	this->forget();
+}
+
+// Picks the child array for a symbol type.
+template<typename S, typename Node, typename Alloc>
+struct trie_children {
+	typedef typename std::conditional<trie_byte_symbol<S>::value,
+	                                  trie_adaptive_children<S, Node, Alloc>,
+	                                  trie_sorted_children<S, Node, Alloc>>::type type;
+};
+
+#endif
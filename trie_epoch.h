@@ -0,0 +1,130 @@
+// trie_epoch.h - Epoch-based reclamation for concurrent tries
+// Copyright (C) 2013  George Hilliard
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef TRIE_EPOCH_H
+#define TRIE_EPOCH_H
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <functional>
+
+// Decides when memory that has been unlinked from a shared structure can be
+// freed.  Every access to the structure happens while pinned; memory retired
+// in epoch e is freed once the epoch has moved on to e + 2, at which point
+// every thread that was pinned when it was unlinked has let go.
+//
+// Pinned threads are counted per epoch (by parity) in a handful of slots,
+// picked by thread, so readers rarely share a cache line.  Pinning is two
+// atomic adds; it never waits.  Only retiring takes a lock.
+class trie_epoch {
+	struct slot {
+		std::atomic<std::size_t> pinned[2];
+		char padding[64 - 2 * sizeof(std::atomic<std::size_t>)];
+	};
+	struct retired {
+		void* p;
+		void (*free)(void*);
+	};
+	static constexpr unsigned slots = 64;
+	// Try to move the epoch on after this many retirements.
+	static constexpr unsigned advance_every = 32;
+
+	slot readers[slots];
+	std::atomic<std::uint64_t> epoch{0};
+	std::mutex retire_lock;
+	std::vector<retired> limbo[3];
+	unsigned since_advance = 0;
+
+	static unsigned my_slot() {
+		static thread_local unsigned mine = std::hash<std::thread::id>()(std::this_thread::get_id()) % slots;
+		return mine;
+	}
+
+public:
+	// Keeps the calling thread pinned for as long as it exists.
+	class guard {
+		friend class trie_epoch;
+		std::atomic<std::size_t>* count;
+		explicit guard(std::atomic<std::size_t>* count) : count{count} {}
+	public:
+		guard(guard&& other) : count{other.count} { other.count = nullptr; }
+		guard(const guard&) =delete;
+		guard& operator=(const guard&) =delete;
+		~guard() {
+			if(count != nullptr)
+				count->fetch_sub(1, std::memory_order_release);
+		}
+	};
+
+	trie_epoch() {
+		for(auto& r: readers) {
+			r.pinned[0] = 0;
+			r.pinned[1] = 0;
+		}
+	}
+	trie_epoch(const trie_epoch&) =delete;
+	trie_epoch& operator=(const trie_epoch&) =delete;
+	// No thread may be pinned any more.
+	~trie_epoch() {
+		for(auto& l: limbo)
+			free_all(l);
+	}
+
+	guard pin() {
+		slot& mine = readers[my_slot()];
+		for(;;) {
+			std::uint64_t e = epoch.load();
+			mine.pinned[e & 1].fetch_add(1);
+			// If the epoch moved on in between, it may not have seen us.
+			if(epoch.load() == e)
+				return guard{&mine.pinned[e & 1]};
+			mine.pinned[e & 1].fetch_sub(1);
+		}
+	}
+
+	// Frees p with free() once no thread can still be looking at it.  It
+	// must already be unreachable for threads that pin from now on.
+	void retire(void* p, void (*free)(void*)) {
+		std::lock_guard<std::mutex> lock(retire_lock);
+		limbo[epoch.load() % 3].push_back(retired{p, free});
+		if(++since_advance >= advance_every)
+			try_advance();
+	}
+
+private:
+	// Moves from epoch e to e + 1 if nobody is still pinned in e - 1, then
+	// frees what was retired in e - 1.  Called with retire_lock held.
+	void try_advance() {
+		std::uint64_t e = epoch.load();
+		for(auto& r: readers)
+			if(r.pinned[(e + 1) & 1].load() != 0)
+				return;
+		epoch.store(e + 1);
+		since_advance = 0;
+		free_all(limbo[(e + 2) % 3]);
+	}
+	static void free_all(std::vector<retired>& l) {
+		for(auto& r: l)
+			r.free(r.p);
+		l.clear();
+	}
+};
+
+#endif
@@ -0,0 +1,143 @@
+// trie_image.h - Binary image format for trie<T>
+// Copyright (C) 2013  George Hilliard
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef TRIE_IMAGE_H
+#define TRIE_IMAGE_H
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <ostream>
+#include <algorithm>
+#include <vector>
+#include <stdexcept>
+#include <type_traits>
+
+#include "trie_simd.h"
+
+// A trie image is a read-only copy of a trie that can be used in place,
+// straight from a file mapped into memory (see trie_view.h).  It holds no
+// pointers, only offsets from its start, and is laid out as:
+//
+//   trie_image_header
+//   the nodes, each one after all of its children:
+//     trie_image_node
+//     its symbols, sorted and padded (see trie_image_layout::padded)
+//     the offsets of its children, 0 for a nullptr child
+//   trie_image_trailer
+//
+// Everything is 8-byte aligned and in the machine's own byte order.
+
+struct trie_image_header {
+	char magic[8];
+	uint32_t version;
+	uint32_t symbol_size;
+};
+
+struct trie_image_node {
+	uint64_t count;  // keys in the subtree
+	uint32_t children;
+	uint32_t is_leaf;
+};
+
+struct trie_image_trailer {
+	uint64_t size;  // of the whole image
+	uint64_t root;
+	char magic[8];
+};
+
+static constexpr char trie_image_magic[8] = {'T', 'R', 'I', 'E', 'I', 'M', 'G', '\0'};
+static constexpr uint32_t trie_image_version = 2;
+
+// Where the parts of a node are, for symbols of type S.
+template<typename S>
+struct trie_image_layout {
+	static_assert(std::is_trivially_copyable<S>::value, "trie images need trivially copyable symbols");
+	typedef trie_symbol_search<S> search;
+
+	// Symbol arrays are padded the same way whatever the build, enough for
+	// the widest vectorized search, so every build reads the same offsets.
+	static std::size_t padded(uint32_t n) {
+		return !trie_byte_symbol<S>::value ? n : n <= 8 ? 8 : n <= 16 ? 16 : (n + 31) & ~31u;
+	}
+	static std::size_t symbols_bytes(uint32_t n) {
+		return (padded(n) * sizeof(S) + 7) & ~std::size_t(7);
+	}
+	static std::size_t node_bytes(uint32_t n) {
+		return sizeof(trie_image_node) + symbols_bytes(n) + n * sizeof(uint64_t);
+	}
+	static const S* symbols(const trie_image_node* node) {
+		return reinterpret_cast<const S*>(node + 1);
+	}
+	static const uint64_t* children(const trie_image_node* node) {
+		return reinterpret_cast<const uint64_t*>(reinterpret_cast<const char*>(node + 1) + symbols_bytes(node->children));
+	}
+};
+
+// Writes an image to a stream, one node at a time.  trie<T>::write_image()
+// drives it.
+template<typename S>
+class trie_image_writer {
+	typedef trie_image_layout<S> layout;
+
+	std::ostream& out;
+	uint64_t position = 0;
+
+	void write(const void* p, std::size_t n) {
+		out.write(static_cast<const char*>(p), n);
+		position += n;
+	}
+	void pad_to(uint64_t end) {
+		static const char zeros[32] = {};
+		while(position < end)
+			write(zeros, std::min<uint64_t>(sizeof(zeros), end - position));
+	}
+
+public:
+	explicit trie_image_writer(std::ostream& out) : out(out) {
+		trie_image_header header;
+		std::memcpy(header.magic, trie_image_magic, sizeof(header.magic));
+		header.version = trie_image_version;
+		header.symbol_size = sizeof(S);
+		write(&header, sizeof(header));
+	}
+
+	// Returns the node's offset.  Its children must already be written.
+	uint64_t node(uint64_t count, bool is_leaf, const std::vector<S>& symbols, const std::vector<uint64_t>& children) {
+		uint64_t offset = position;
+		trie_image_node n;
+		n.count = count;
+		n.children = symbols.size();
+		n.is_leaf = is_leaf;
+		write(&n, sizeof(n));
+		write(symbols.data(), symbols.size() * sizeof(S));
+		pad_to(offset + sizeof(n) + layout::symbols_bytes(n.children));
+		write(children.data(), children.size() * sizeof(uint64_t));
+		return offset;
+	}
+
+	void finish(uint64_t root) {
+		trie_image_trailer trailer;
+		trailer.size = position + sizeof(trailer);
+		trailer.root = root;
+		std::memcpy(trailer.magic, trie_image_magic, sizeof(trailer.magic));
+		write(&trailer, sizeof(trailer));
+		if(!out)
+			throw std::runtime_error("trie image: write failed");
+	}
+};
+
+#endif
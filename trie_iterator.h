@@ -4,174 +4,267 @@
 #include <iterator>
 
 #include "trie.h"
+#include "trie_path.h"
 
-template<typename T>
-class trie<T>::iterator : public std::iterator<std::bidirectional_iterator_tag, T> {
-	friend class trie<T>;
+template<typename T, typename Alloc, typename Mapped>
+class trie<T, Alloc, Mapped>::iterator : public std::iterator<std::bidirectional_iterator_tag, T> {
+	friend class trie<T, Alloc, Mapped>;
+	friend class trie<T, Alloc, Mapped>::key_cursor;
 
 	// data members and types
+
+	// Each state is a node on the path and the index of the child being followed
+	// out of it.  The top state is either at a nullptr child, which ends a key,
+	// or at npos to mean the node's own key.  The key is the symbols of the
+	// children followed, and is only put together in built when the iterator
+	// is dereferenced; the first synced of them are already there.
+	typedef typename trie<T, Alloc, Mapped>::child_map_type::size_type index_type;
+	static constexpr index_type npos = trie<T, Alloc, Mapped>::child_map_type::npos;
 	struct state {
-		const trie<T>* node;
-		typename trie<T>::child_map_type::const_iterator node_map_it;
+		const typename trie<T, Alloc, Mapped>::node* node;
+		index_type index;
 
-		state(const trie<T>* const node, const typename trie<T>::child_map_type::const_iterator& node_map_it ) :
-			node{node}, node_map_it{node_map_it} {}
-		state(const trie<T>* const node, const typename trie<T>::child_map_type::const_iterator&& node_map_it ) :
-			node{node}, node_map_it{std::move(node_map_it)} {}
 		bool operator==(const state& other) const {
-			return node == other.node && node_map_it == other.node_map_it;
+			return node == other.node && index == other.index;
 		}
 	};
+	typedef trie_path<state> path_type;
 
-	std::stack<state> parents;
-	// TODO: we could switch the use of push_back and pop_back for insert and erase
-	// using an end iterator, to gain some additional compatibility.
-	T built;
+	path_type parents;
 	bool at_end;
-	bool at_leaf;
+	mutable size_t synced = 0;
+	mutable T built;
 
 public:
 	typedef const T value_type;
 	iterator() =default;
-	iterator(const trie<T>* node) {
-		built.reserve(16);  // Speed up walking around
-		parents.emplace(node, node->children.cbegin());
-		at_leaf = parents.top().node->is_leaf;
-		at_end = (parents.top().node->children.size() == 0 && !at_leaf);
-		fall_down();
+	iterator(const typename trie<T, Alloc, Mapped>::node* node) : at_end{false} {
+		parents.push({node, node->is_leaf ? npos : node->children.first()});
+		if(!node->is_leaf)
+			fall_down();
 	}
 	~iterator() =default;
-	iterator(const typename trie<T>::iterator& other) =default;
-	iterator(const typename trie<T>::iterator&& other) :
+	// A copy doesn't take the key along; it builds its own if it needs one.
+	iterator(const typename trie<T, Alloc, Mapped>::iterator& other) :
+		parents{other.parents},
+		at_end{other.at_end}
+	{}
+	iterator(typename trie<T, Alloc, Mapped>::iterator&& other) :
 		parents{std::move(other.parents)},
-		built{std::move(other.built)},
 		at_end{other.at_end},
-		at_leaf{other.at_leaf}
-	{}
-	iterator& operator=(typename trie<T>::iterator other) {
+		synced{other.synced},
+		built{std::move(other.built)}
+	{
+		other.synced = 0;
+	}
+	iterator& operator=(typename trie<T, Alloc, Mapped>::iterator other) {
 		swap(*this, other);
 		return *this;
 	}
 
-	void swap(typename trie<T>::iterator& other) {
-		std::swap(parents, other.parents);
-		std::swap(built, other.built);
+	void swap(typename trie<T, Alloc, Mapped>::iterator& other) {
+		parents.swap(other.parents);
 		std::swap(at_end, other.at_end);
-		std::swap(at_leaf, other.at_leaf);
+		std::swap(synced, other.synced);
+		std::swap(built, other.built);
 	}
-	static void swap(typename trie<T>::iterator& a, typename trie<T>::iterator& b) { a.swap(b); }
+	static void swap(typename trie<T, Alloc, Mapped>::iterator& a, typename trie<T, Alloc, Mapped>::iterator& b) { a.swap(b); }
 
-	const T& operator*() const { return built; }
-	const T* operator->() const { return &built; }
+	const T& operator*() const { return key(); }
+	const T* operator->() const { return &key(); }
 
-	trie<T>::iterator& operator++() {
-		remove_state_and_advance();
+	// The value mapped to the current key, in a trie_map.
+	typename trie_payload<Mapped>::reference value() const {
+		return const_cast<typename trie<T, Alloc, Mapped>::node*>(parents.top().node)->payload.get();
+	}
 
-		// Handle consequences of advance
+	trie<T, Alloc, Mapped>::iterator& operator++() {
+		if(parents.top().index == npos)
+			// The node's own key comes first; its children follow.
+			set_top_index(parents.top().node->children.first());
+		else
+			leave_child();
 		fall_down();
 		return *this;
 	}
-	trie<T>::iterator operator++(int) {
+	trie<T, Alloc, Mapped>::iterator operator++(int) {
 		iterator temp {*this};
 		++*this;
 		return temp;
 	}
-	trie<T>::iterator& operator--() {
-		while(!can_go_back()) {
-			if(!at_leaf)
-				built.pop_back();
-			if(parents.size() == 1) {
-				at_end = true;
-				return *this;
-			}
-			else {
-				parents.pop();
-				at_leaf = false;
-			}
-		}
-		remove_state_and_regress();
-		while(!at_valid_leaf())
-			step_down(false);
-		step_down(false);
+	trie<T, Alloc, Mapped>::iterator& operator--() {
+		if(at_end)
+			at_end = false;
+		else if(parents.top().index == npos)
+			// Everything under this node sorts after it, so back out of it.
+			pop();
+		climb_back();
 		return *this;
 	}
-	trie<T>::iterator operator--(int) {
+	trie<T, Alloc, Mapped>::iterator operator--(int) {
 		iterator temp {*this};
 		--*this;
 		return temp;
 	}
 
-	bool operator==(const typename trie<T>::iterator& other) const {
-		return parents.top() == other.parents.top() && at_end == other.at_end;
+	bool operator==(const typename trie<T, Alloc, Mapped>::iterator& other) const {
+		return at_end == other.at_end && (at_end || parents.top() == other.parents.top());
 	}
-	bool operator!=(const typename trie<T>::iterator& other) const { return !operator==(other); }
+	bool operator!=(const typename trie<T, Alloc, Mapped>::iterator& other) const { return !operator==(other); }
 private:
-	iterator(const std::stack<state>& parents, const T& built, bool at_end, bool at_leaf) :
-		parents{parents}, built{built}, at_end{at_end}, at_leaf{at_leaf} {}
+	iterator(path_type&& parents, bool at_end) :
+		parents{std::move(parents)}, at_end{at_end} {}
+
+	// Puts the key together from the path, reusing what is still there.
+	const T& key() const {
+		size_t symbols = parents.size() - (parents.top().index == npos ? 1 : 0);
+		built.resize(synced);
+		for(; synced < symbols; ++synced)
+			built.push_back(parents[synced].node->children.symbol(parents[synced].index));
+		return built;
+	}
+	// Sets the key when it is already at hand, as when it was just inserted.
+	template<typename K> void set_key(K&& key) {
+		built = std::forward<K>(key);
+		synced = built.size();
+	}
+
+	// Every change to the path goes through these, to keep synced in step.
+	void push(const state& s) { parents.push(s); }
+	void pop() {
+		parents.pop();
+		if(synced > parents.size())
+			synced = parents.size();
+	}
+	void set_top_index(index_type index) {
+		parents.top().index = index;
+		if(synced >= parents.size())
+			synced = parents.size() - 1;
+	}
+
+	void inline leave_child() {
+		set_top_index(parents.top().node->children.next(parents.top().index));
+	}
+	// Moves forward from the top state to the first key at or after it.
 	void fall_down() {
-		while(!at_valid_leaf()) {
-			if(parents.top().node_map_it == parents.top().node->children.cend()) {
+		for(;;) {
+			const state& top = parents.top();
+			if(top.index == npos)
+				return;
+			if(top.index == top.node->children.end_slot()) {
 				if(parents.size() == 1) {
 					at_end = true;
 					return;
 				}
-				else {
-					parents.pop();
-					remove_state_and_advance();
-				}
+				pop();
+				leave_child();
+				continue;
 			}
-			else
-				step_down();
+			const auto child = top.node->children.child(top.index);
+			if(child == nullptr)
+				return;
+			// The next sibling is visited once this child's subtree is done, so
+			// start loading it now.
+			auto sibling = top.node->children.next(top.index);
+			if(sibling != top.node->children.end_slot())
+				__builtin_prefetch(top.node->children.child(sibling));
+			push({child, child->is_leaf ? npos : child->children.first()});
 		}
-		step_down();
 	}
-	void inline walk_up() {
-		built.pop_back();
-		parents.pop();
-	}
-	void inline remove_state_and_advance() {
-		// Remove old state and advance
-		if(!at_leaf) {
-			built.pop_back();
-			++parents.top().node_map_it;
+	// Moves backward from the top state, whose child has already been left,
+	// to the last key before it.
+	void climb_back() {
+		while(parents.top().index == parents.top().node->children.first()) {
+			if(parents.top().node->is_leaf) {
+				set_top_index(npos);
+				return;
+			}
+			pop();
+		}
+		set_top_index(parents.top().node->children.prev(parents.top().index));
+		// Take the last child all the way down.  In a plain trie every node
+		// below the root has at least one child, so this ends on a nullptr
+		// child; in a trie_map it ends on a leaf without children.
+		for(;;) {
+			const state& top = parents.top();
+			const auto child = top.node->children.child(top.index);
+			if(child == nullptr)
+				return;
+			if(child->children.empty()) {
+				push({child, npos});
+				return;
+			}
+			push({child, child->children.last()});
 		}
-		else
-			at_leaf = false;
 	}
-	bool inline can_go_back() {
-		return (!at_leaf && parents.top().node->is_leaf) ||
-		       (parents.top().node_map_it != parents.top().node->children.cbegin()) ||
-		       (at_end && !parents.top().node->children.empty());
+};
+
+// Visits the keys of a trie in order, keeping the current key up to date as
+// it goes.  Unlike an iterator it only moves forward and isn't meant to be
+// copied, so it is the cheapest way to scan.
+template<typename T, typename Alloc, typename Mapped>
+class trie<T, Alloc, Mapped>::key_cursor {
+	typedef typename trie<T, Alloc, Mapped>::iterator::state state;
+
+	trie_path<state> parents;
+	T built;
+	bool at_end;
+
+public:
+	explicit key_cursor(const typename trie<T, Alloc, Mapped>::node* node) : at_end{false} {
+		parents.push({node, node->is_leaf ? iterator::npos : node->children.first()});
+		if(!node->is_leaf)
+			fall_down();
 	}
-	void inline remove_state_and_regress() {
-		// This function assumes we can_go_back().
-		if(at_end)
-			at_end = false;
-		else
-			built.pop_back();
-		if(parents.top().node_map_it == parents.top().node->children.cbegin())
-			at_leaf = true;
+
+	// Whether there is a current key
+	bool valid() const { return !at_end; }
+	const T& key() const { return built; }
+	typename trie_payload<Mapped>::reference value() const {
+		return const_cast<typename trie<T, Alloc, Mapped>::node*>(parents.top().node)->payload.get();
+	}
+
+	void next() {
+		if(parents.top().index == iterator::npos)
+			parents.top().index = parents.top().node->children.first();
 		else
-			--parents.top().node_map_it;
-	}
-	bool inline at_valid_leaf() {
-		return parents.top().node_map_it != parents.top().node->children.cend() &&
-		       (at_leaf ||
-		        (parents.top().node_map_it->second.get() == nullptr));
-	}
-	void step_down(bool forward = true) {
-		if(!at_leaf) {
-			built.push_back(parents.top().node_map_it->first);
-			if(parents.top().node_map_it->second.get() != nullptr) {
-				parents.emplace( parents.top().node_map_it->second.get(),
-				                 forward?
-				                  parents.top().node_map_it->second.get()->children.cbegin() :
-				                  --parents.top().node_map_it->second.get()->children.cend() );
-				if(forward)
-					at_leaf = parents.top().node->is_leaf;
+			leave_child();
+		fall_down();
+	}
+
+private:
+	void leave_child() {
+		built.pop_back();
+		parents.top().index = parents.top().node->children.next(parents.top().index);
+	}
+	// Same as iterator::fall_down(), building the key on the way.
+	void fall_down() {
+		for(;;) {
+			state& top = parents.top();
+			if(top.index == iterator::npos)
+				return;
+			if(top.index == top.node->children.end_slot()) {
+				if(parents.size() == 1) {
+					at_end = true;
+					return;
+				}
+				parents.pop();
+				leave_child();
+				continue;
 			}
+			built.push_back(top.node->children.symbol(top.index));
+			const auto child = top.node->children.child(top.index);
+			if(child == nullptr)
+				return;
+			auto sibling = top.node->children.next(top.index);
+			if(sibling != top.node->children.end_slot())
+				__builtin_prefetch(top.node->children.child(sibling));
+			parents.push({child, child->is_leaf ? iterator::npos : child->children.first()});
 		}
 	}
 };
 
+template<typename T, typename Alloc, typename Mapped>
+constexpr typename trie<T, Alloc, Mapped>::iterator::index_type trie<T, Alloc, Mapped>::iterator::npos;
+
 #endif
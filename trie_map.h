@@ -0,0 +1,140 @@
+// trie_map.h - An associative trie
+// Copyright (C) 2013  George Hilliard
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef TRIE_MAP_H
+#define TRIE_MAP_H
+
+#include <utility>
+#include <stdexcept>
+#include <initializer_list>
+
+#include "trie.h"
+
+// A trie that maps each key to a V.  Values live in the node their key ends
+// on, so a lookup is one descent, with no separate table to hash into.
+// Everything that doesn't involve values (erase, find, the prefix and order
+// statistic queries, iteration) is the same as for trie.  Iterators
+// dereference to the key; it.value() is the mapped value.
+template<typename K, typename V, typename Alloc = trie_heap_allocator>
+class trie_map : public trie<K, Alloc, V> {
+	typedef trie<K, Alloc, V> base;
+
+public:
+	// misc. declarations
+	typedef typename base::iterator iterator;
+	typedef typename base::const_iterator const_iterator;
+	typedef typename base::size_type size_type;
+	typedef K key_type;
+	typedef V mapped_type;
+
+	// constructors
+	trie_map() =default;
+	template<typename InputIt> trie_map(InputIt, InputIt);
+	trie_map(std::initializer_list<std::pair<K, V>>);
+
+	// element access
+	V& operator[](const key_type&);
+	V& at(const key_type&);
+	const V& at(const key_type&) const;
+
+	// modifiers
+	std::pair<iterator,bool> insert(const std::pair<K, V>&);
+	template<typename InputIt> void insert(InputIt, const InputIt&);
+	// Unlike std::map, the key is passed apart from the value's constructor
+	// arguments, so emplace() is the same as try_emplace().
+	template<typename... Args> std::pair<iterator,bool> emplace(const key_type&, Args&&...);
+	template<typename... Args> std::pair<iterator,bool> try_emplace(const key_type&, Args&&...);
+	template<typename M> std::pair<iterator,bool> insert_or_assign(const key_type&, M&&);
+};
+
+template<typename K, typename V, typename Alloc>
+template<typename InputIt>
+trie_map<K, V, Alloc>::trie_map(InputIt first, InputIt last)
+{
+	insert(first, last);
+}
+
+template<typename K, typename V, typename Alloc>
+trie_map<K, V, Alloc>::trie_map(std::initializer_list<std::pair<K, V>> l)
+{
+	insert(l.begin(), l.end());
+}
+
+template<typename K, typename V, typename Alloc>
+V& trie_map<K, V, Alloc>::operator[](const key_type& key)
+{
+	// Goes straight to the node, without building an iterator.
+	bool inserted;
+	return this->insert_path(key, nullptr, inserted)->payload.get();
+}
+
+template<typename K, typename V, typename Alloc>
+V& trie_map<K, V, Alloc>::at(const key_type& key)
+{
+	return const_cast<V&>(static_cast<const trie_map&>(*this).at(key));
+}
+
+template<typename K, typename V, typename Alloc>
+const V& trie_map<K, V, Alloc>::at(const key_type& key) const
+{
+	auto n = this->find_node(key);
+	if(n == nullptr)
+		throw std::out_of_range("trie_map::at");
+	return n->payload.get();
+}
+
+template<typename K, typename V, typename Alloc>
+auto trie_map<K, V, Alloc>::insert(const std::pair<K, V>& value) -> std::pair<iterator,bool>
+{
+	return try_emplace(value.first, value.second);
+}
+
+template<typename K, typename V, typename Alloc>
+template<typename InputIt>
+void trie_map<K, V, Alloc>::insert(InputIt start, const InputIt& finish)
+{
+	bool inserted;
+	for(; start != finish; ++start)
+		this->insert_path(start->first, nullptr, inserted, start->second);
+}
+
+template<typename K, typename V, typename Alloc>
+template<typename... Args>
+auto trie_map<K, V, Alloc>::emplace(const key_type& key, Args&&... args) -> std::pair<iterator,bool>
+{
+	return try_emplace(key, std::forward<Args>(args)...);
+}
+
+template<typename K, typename V, typename Alloc>
+template<typename... Args>
+auto trie_map<K, V, Alloc>::try_emplace(const key_type& key, Args&&... args) -> std::pair<iterator,bool>
+{
+	// The value is only constructed if key is new.
+	return this->insert_with(key, std::forward<Args>(args)...);
+}
+
+template<typename K, typename V, typename Alloc>
+template<typename M>
+auto trie_map<K, V, Alloc>::insert_or_assign(const key_type& key, M&& value) -> std::pair<iterator,bool>
+{
+	auto result = try_emplace(key, std::forward<M>(value));
+	if(!result.second)
+		// try_emplace() only uses value when it inserts.
+		result.first.value() = std::forward<M>(value);
+	return result;
+}
+
+#endif
@@ -0,0 +1,124 @@
+// trie_path.h - A small stack for the paths of trie iterators
+// Copyright (C) 2013  George Hilliard
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef TRIE_PATH_H
+#define TRIE_PATH_H
+
+#include <cstddef>
+#include <cstring>
+#include <utility>
+#include <type_traits>
+
+// A stack of trivially copyable states that keeps its first N in place and
+// only goes to the heap for deeper paths.  Copying one copies just the
+// states in use.  It is a std::stack as far as the iterators are concerned,
+// but can also be read from the bottom up.
+template<typename S, std::size_t N = 16>
+class trie_path {
+	static_assert(std::is_trivially_copyable<S>::value, "trie_path needs trivially copyable states");
+
+	S* states;
+	std::size_t used = 0;
+	std::size_t capacity = N;
+	typename std::aligned_storage<sizeof(S) * N, alignof(S)>::type in_place;
+
+	S* in_place_states() { return reinterpret_cast<S*>(&in_place); }
+	bool on_heap() const { return capacity != N; }
+
+	void grow() {
+		S* bigger = new S[capacity * 2];
+		std::memcpy(bigger, states, used * sizeof(S));
+		if(on_heap())
+			delete[] states;
+		states = bigger;
+		capacity *= 2;
+	}
+
+	// Takes other's states; *this must be empty and in place.
+	void take(trie_path& other) {
+		if(other.on_heap()) {
+			states = other.states;
+			capacity = other.capacity;
+			other.states = other.in_place_states();
+			other.capacity = N;
+		}
+		else
+			std::memcpy(states, other.states, other.used * sizeof(S));
+		used = other.used;
+		other.used = 0;
+	}
+	void release() {
+		if(on_heap())
+			delete[] states;
+		states = in_place_states();
+		capacity = N;
+		used = 0;
+	}
+
+public:
+	trie_path() : states{in_place_states()} {}
+	trie_path(const trie_path& other) : trie_path() {
+		while(capacity < other.used)
+			grow();
+		std::memcpy(states, other.states, other.used * sizeof(S));
+		used = other.used;
+	}
+	trie_path(trie_path&& other) : trie_path() {
+		take(other);
+	}
+	~trie_path() { release(); }
+
+	trie_path& operator=(const trie_path& other) {
+		if(this != &other) {
+			used = 0;
+			while(capacity < other.used)
+				grow();
+			std::memcpy(states, other.states, other.used * sizeof(S));
+			used = other.used;
+		}
+		return *this;
+	}
+	trie_path& operator=(trie_path&& other) {
+		if(this != &other) {
+			release();
+			take(other);
+		}
+		return *this;
+	}
+	void swap(trie_path& other) {
+		trie_path temp{std::move(other)};
+		other = std::move(*this);
+		*this = std::move(temp);
+	}
+
+	bool empty() const { return used == 0; }
+	std::size_t size() const { return used; }
+
+	void push(const S& s) {
+		if(used == capacity)
+			grow();
+		states[used++] = s;
+	}
+	void pop() { --used; }
+	S& top() { return states[used - 1]; }
+	const S& top() const { return states[used - 1]; }
+
+	// From the bottom (the root) up
+	S& operator[](std::size_t i) { return states[i]; }
+	const S& operator[](std::size_t i) const { return states[i]; }
+};
+
+#endif
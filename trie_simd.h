@@ -0,0 +1,145 @@
+// trie_simd.h - Child symbol search for trie<T>
+// Copyright (C) 2013  George Hilliard
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef TRIE_SIMD_H
+#define TRIE_SIMD_H
+
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+#include <type_traits>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+// True for symbol types that the vectorized search handles.
+template<typename S>
+struct trie_byte_symbol : std::integral_constant<bool, std::is_integral<S>::value && sizeof(S) == 1 &&
+                                                       !std::is_same<S, bool>::value> {};
+
+// Searches a node's sorted, packed array of child symbols.  The generic
+// version is a binary search and works for any symbol with < and ==.
+template<typename S, typename Enable = void>
+struct trie_symbol_search {
+	typedef uint32_t size_type;
+	static constexpr size_type npos = UINT32_MAX;
+
+	// How many symbols to allocate room for, so searches never read past the array.
+	static size_type padded(size_type capacity) { return capacity; }
+
+	// Index of the first symbol not less than s.
+	static size_type lower_bound(const S* keys, size_type n, const S& s) {
+		return std::lower_bound(keys, keys + n, s) - keys;
+	}
+	// Index of s, or npos.
+	static size_type find(const S* keys, size_type n, const S& s) {
+		size_type i = lower_bound(keys, n, s);
+		return (i != n && keys[i] == s) ? i : npos;
+	}
+};
+
+#if defined(__SSE2__)
+// Byte-sized symbols (the char of a std::string) are compared 16 or 32 at
+// a time: one vector compare, then movemask turns the result into a bit per
+// symbol.  The arrays are padded so whole vectors can always be loaded.
+template<typename S>
+struct trie_symbol_search<S, typename std::enable_if<trie_byte_symbol<S>::value>::type> {
+	typedef uint32_t size_type;
+	static constexpr size_type npos = UINT32_MAX;
+
+	static size_type padded(size_type capacity) {
+		return capacity <= 8 ? 8 : capacity <= 16 ? 16 : (capacity + 31) & ~31u;
+	}
+
+	static size_type lower_bound(const S* keys, size_type n, const S& s) {
+		// Keys are sorted, so the insertion point is the number of keys less than s.
+		size_type below = 0;
+		each_chunk(keys, n, s, [&below](uint32_t, uint32_t less) { below += __builtin_popcount(less); return false; });
+		return below;
+	}
+	static size_type find(const S* keys, size_type n, const S& s) {
+		size_type found = npos;
+		each_chunk(keys, n, s, [&found](uint32_t base, uint32_t equal_bits) {
+			if(equal_bits == 0)
+				return false;
+			found = base + __builtin_ctz(equal_bits);
+			return true;
+		}, true);
+		return found;
+	}
+
+private:
+	// The SSE2 byte compare is signed; unsigned symbols are shifted into signed order.
+	static constexpr int bias = std::is_signed<S>::value ? 0 : -128;
+
+	static uint32_t valid_bits(size_type remaining, size_type width) {
+		return remaining >= width ? (width == 32 ? ~0u : (1u << width) - 1) : (1u << remaining) - 1;
+	}
+
+	// Calls f(base, mask) with a bit per symbol in each chunk, until f returns true.
+	// The mask has equal symbols if equal is set, or smaller symbols if not.
+	template<typename F>
+	static void each_chunk(const S* keys, size_type n, const S& s, F f, bool equal = false) {
+		if(n == 0)
+			return;
+		const char* bytes = reinterpret_cast<const char*>(keys);
+		const char needle = static_cast<char>(s + bias);
+		const __m128i bias16 = _mm_set1_epi8(static_cast<char>(bias));
+		const __m128i needle16 = _mm_set1_epi8(needle);
+
+		if(n <= 8) {
+			__m128i k = _mm_add_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(bytes)), bias16);
+			__m128i r = equal ? _mm_cmpeq_epi8(k, needle16) : _mm_cmplt_epi8(k, needle16);
+			f(0, static_cast<uint32_t>(_mm_movemask_epi8(r)) & valid_bits(n, 8));
+			return;
+		}
+
+		size_type i = 0;
+#if defined(__AVX2__)
+		if(n > 16) {
+			const __m256i bias32 = _mm256_set1_epi8(static_cast<char>(bias));
+			const __m256i needle32 = _mm256_set1_epi8(needle);
+			for(; i < n; i += 32) {
+				__m256i k = _mm256_add_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(bytes + i)), bias32);
+				__m256i r = equal ? _mm256_cmpeq_epi8(k, needle32) : _mm256_cmpgt_epi8(needle32, k);
+				if(f(i, static_cast<uint32_t>(_mm256_movemask_epi8(r)) & valid_bits(n - i, 32)))
+					return;
+			}
+			return;
+		}
+#endif
+		for(; i < n; i += 16) {
+			__m128i k = _mm_add_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(bytes + i)), bias16);
+			__m128i r = equal ? _mm_cmpeq_epi8(k, needle16) : _mm_cmplt_epi8(k, needle16);
+			if(f(i, static_cast<uint32_t>(_mm_movemask_epi8(r)) & valid_bits(n - i, 16)))
+				return;
+		}
+	}
+};
+
+template<typename S>
+constexpr typename trie_symbol_search<S, typename std::enable_if<trie_byte_symbol<S>::value>::type>::size_type
+	trie_symbol_search<S, typename std::enable_if<trie_byte_symbol<S>::value>::type>::npos;
+#endif
+
+template<typename S, typename Enable>
+constexpr typename trie_symbol_search<S, Enable>::size_type trie_symbol_search<S, Enable>::npos;
+
+#endif
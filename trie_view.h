@@ -0,0 +1,307 @@
+// trie_view.h - A read-only trie used in place from a binary image
+// Copyright (C) 2013  George Hilliard
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef TRIE_VIEW_H
+#define TRIE_VIEW_H
+
+#include <stack>
+#include <string>
+#include <utility>
+#include <cstdint>
+#include <cstring>
+#include <cerrno>
+#include <stdexcept>
+#include <system_error>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "trie_image.h"
+
+// Answers queries straight from an image written by trie<T>::write_image(),
+// without building any nodes.  Opening a file maps it read-only and shared,
+// so processes viewing the same image share its pages.
+template<typename T>
+class trie_view {
+	// data members and types
+	typedef typename T::value_type symbol;
+	typedef trie_image_layout<symbol> layout;
+
+	const char* image = nullptr;
+	std::size_t length = 0;
+	bool mapped = false;
+	// A view with no image, such as one moved from, has an empty root.
+	static const trie_image_node empty_root;
+	const trie_image_node* root = &empty_root;
+
+public:
+	// misc. declarations
+	class iterator;
+	typedef T key_type;
+	typedef T value_type;
+	typedef size_t size_type;
+	typedef iterator const_iterator;
+
+	// constructors
+	explicit trie_view(const std::string& path);
+	// Views an image in memory, which must be 8-byte aligned and outlive the view.
+	trie_view(const void*, std::size_t);
+	trie_view(const trie_view&) =delete;
+	trie_view(trie_view&&);
+
+	~trie_view();
+
+	// operators
+	trie_view& operator=(trie_view);
+
+	// iterators and related
+	iterator begin() const;
+	iterator end() const;
+	const_iterator cbegin() const { return begin(); }
+	const_iterator cend() const { return end(); }
+
+	// other members
+	bool empty() const { return root->count == 0; }
+	size_type size() const { return root->count; }
+
+	const_iterator find(const key_type&) const;
+	size_type count(const key_type& key) const { return contains(key) ? 1 : 0; }
+	bool contains(const key_type&) const;
+
+	std::pair<const_iterator,const_iterator> equal_prefix_range(const key_type&) const;
+	size_type count_prefix(const key_type&) const;
+
+	void swap(trie_view&);
+	static void swap(trie_view& a, trie_view& b) { a.swap(b); }
+
+private:
+	void check() const;
+	bool descend(const key_type&, iterator&, const trie_image_node*&) const;
+
+	// Child i of n, or nullptr
+	const trie_image_node* child(const trie_image_node* n, uint32_t i) const {
+		uint64_t offset = layout::children(n)[i];
+		return offset == 0 ? nullptr : reinterpret_cast<const trie_image_node*>(image + offset);
+	}
+	static uint32_t find_symbol(const trie_image_node* n, const symbol& s) {
+		return layout::search::find(layout::symbols(n), n->children, s);
+	}
+	static uint64_t count_of(const trie_image_node* n) { return n == nullptr ? 1 : n->count; }
+};
+
+// Definition of trie_view<T>::iterator
+#include "trie_view_iterator.h"
+
+template<typename T>
+trie_view<T>::trie_view(const std::string& path)
+{
+	int fd = ::open(path.c_str(), O_RDONLY);
+	if(fd < 0)
+		throw std::system_error(errno, std::generic_category(), path);
+	struct stat st;
+	if(::fstat(fd, &st) < 0) {
+		int error = errno;
+		::close(fd);
+		throw std::system_error(error, std::generic_category(), path);
+	}
+	length = st.st_size;
+	void* p = length == 0 ? MAP_FAILED : ::mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+	int error = errno;
+	::close(fd);
+	if(p == MAP_FAILED) {
+		if(length == 0)
+			throw std::runtime_error("trie image: " + path + " is empty");
+		throw std::system_error(error, std::generic_category(), path);
+	}
+	image = static_cast<const char*>(p);
+	mapped = true;
+
+	try {
+		check();
+	}
+	catch(...) {
+		::munmap(const_cast<char*>(image), length);
+		throw;
+	}
+}
+
+template<typename T>
+const trie_image_node trie_view<T>::empty_root = {0, 0, 0};
+
+template<typename T>
+trie_view<T>::trie_view(const void* data, std::size_t size) :
+	image{static_cast<const char*>(data)}, length{size}
+{
+	check();
+}
+
+template<typename T>
+trie_view<T>::trie_view(trie_view&& other)
+{
+	swap(other);
+}
+
+template<typename T>
+trie_view<T>::~trie_view()
+{
+	if(mapped)
+		::munmap(const_cast<char*>(image), length);
+}
+
+template<typename T>
+trie_view<T>& trie_view<T>::operator=(trie_view other)
+{
+	swap(other);
+	return *this;
+}
+
+template<typename T>
+void trie_view<T>::check() const
+{
+	// Only the framing is checked; the nodes are trusted.
+	if(reinterpret_cast<uintptr_t>(image) % 8 != 0)
+		throw std::invalid_argument("trie image: not 8-byte aligned");
+	if(length < sizeof(trie_image_header) + sizeof(trie_image_node) + sizeof(trie_image_trailer))
+		throw std::runtime_error("trie image: too short");
+
+	const trie_image_header* header = reinterpret_cast<const trie_image_header*>(image);
+	const trie_image_trailer* trailer = reinterpret_cast<const trie_image_trailer*>(image + length - sizeof(trie_image_trailer));
+	if(std::memcmp(header->magic, trie_image_magic, sizeof(header->magic)) != 0 ||
+	   std::memcmp(trailer->magic, trie_image_magic, sizeof(trailer->magic)) != 0)
+		throw std::runtime_error("trie image: bad magic number");
+	if(header->version != trie_image_version)
+		throw std::runtime_error("trie image: unknown version");
+	if(header->symbol_size != sizeof(symbol))
+		throw std::runtime_error("trie image: written for a different symbol type");
+	if(trailer->size != length || trailer->root < sizeof(trie_image_header) ||
+	   trailer->root > length - sizeof(trie_image_trailer) - sizeof(trie_image_node))
+		throw std::runtime_error("trie image: truncated");
+
+	const_cast<trie_view*>(this)->root = reinterpret_cast<const trie_image_node*>(image + trailer->root);
+}
+
+template<typename T>
+auto trie_view<T>::begin() const -> iterator
+{
+	return {this, root};
+}
+
+template<typename T>
+auto trie_view<T>::end() const -> iterator
+{
+	std::stack<typename iterator::state> temp;
+	temp.push({root, root->children});
+	return {this, std::move(temp), T{}, true};
+}
+
+template<typename T>
+bool trie_view<T>::descend(const key_type& key, iterator& it, const trie_image_node*& currentNode) const
+{
+	// Same as trie<T>::descend().
+	currentNode = root;
+	for(auto inputIt = key.cbegin(); inputIt != key.cend(); ++inputIt) {
+		if(currentNode == nullptr)
+			return false;
+		auto index = find_symbol(currentNode, *inputIt);
+		if(index == layout::search::npos)
+			return false;
+		it.parents.push({currentNode, index});
+		currentNode = child(currentNode, index);
+	}
+	return true;
+}
+
+template<typename T>
+auto trie_view<T>::find(const key_type& key) const -> const_iterator
+{
+	iterator it{this, std::stack<typename iterator::state>{}, key, false};
+	const trie_image_node* currentNode;
+	if(!descend(key, it, currentNode))
+		return cend();
+
+	if(currentNode != nullptr) {
+		if(!currentNode->is_leaf)
+			return cend();
+		it.parents.push({currentNode, iterator::npos});
+	}
+	return it;
+}
+
+template<typename T>
+bool trie_view<T>::contains(const key_type& key) const
+{
+	const trie_image_node* currentNode = root;
+
+	for(auto inputIt = key.cbegin(); inputIt != key.cend(); ++inputIt) {
+		auto index = find_symbol(currentNode, *inputIt);
+		if(index == layout::search::npos)
+			return false;
+		const trie_image_node* next = child(currentNode, index);
+		if(next == nullptr)
+			return inputIt + 1 == key.cend();
+		currentNode = next;
+	}
+	return currentNode->is_leaf;
+}
+
+template<typename T>
+auto trie_view<T>::equal_prefix_range(const key_type& prefix) const -> std::pair<const_iterator,const_iterator>
+{
+	if(prefix.empty())
+		return {cbegin(), cend()};
+
+	iterator first{this, std::stack<typename iterator::state>{}, prefix, false};
+	const trie_image_node* subtree;
+	if(!descend(prefix, first, subtree))
+		return {cend(), cend()};
+
+	iterator last{first};
+	++last;
+	if(subtree != nullptr) {
+		first.parents.push({subtree, subtree->is_leaf ? iterator::npos : 0});
+		first.fall_down();
+	}
+	return {std::move(first), std::move(last)};
+}
+
+template<typename T>
+auto trie_view<T>::count_prefix(const key_type& prefix) const -> size_type
+{
+	const trie_image_node* currentNode = root;
+
+	for(auto inputIt = prefix.cbegin(); inputIt != prefix.cend(); ++inputIt) {
+		if(currentNode == nullptr)
+			return 0;
+		auto index = find_symbol(currentNode, *inputIt);
+		if(index == layout::search::npos)
+			return 0;
+		currentNode = child(currentNode, index);
+	}
+	return count_of(currentNode);
+}
+
+template<typename T>
+void trie_view<T>::swap(trie_view& other)
+{
+	std::swap(image, other.image);
+	std::swap(length, other.length);
+	std::swap(mapped, other.mapped);
+	std::swap(root, other.root);
+}
+
+#endif
@@ -0,0 +1,135 @@
+#ifndef TRIE_VIEW_ITERATOR_H
+#define TRIE_VIEW_ITERATOR_H
+
+#include <iterator>
+
+#include "trie_view.h"
+
+template<typename T>
+class trie_view<T>::iterator : public std::iterator<std::bidirectional_iterator_tag, T> {
+	friend class trie_view<T>;
+
+	// data members and types
+
+	// Works like trie<T>::iterator, over image nodes.  Each state is a node on
+	// the path and the index of the child being followed out of it, or npos
+	// for the node's own key.
+	static constexpr uint32_t npos = trie_view<T>::layout::search::npos;
+	struct state {
+		const trie_image_node* node;
+		uint32_t index;
+
+		bool operator==(const state& other) const {
+			return node == other.node && index == other.index;
+		}
+	};
+
+	const trie_view<T>* view;
+	std::stack<state> parents;
+	T built;
+	bool at_end;
+
+public:
+	typedef const T value_type;
+	iterator() =default;
+	iterator(const trie_view<T>* view, const trie_image_node* node) : view{view}, at_end{false} {
+		parents.push({node, node->is_leaf ? npos : 0});
+		if(!node->is_leaf)
+			fall_down();
+	}
+
+	const T& operator*() const { return built; }
+	const T* operator->() const { return &built; }
+
+	iterator& operator++() {
+		if(parents.top().index == npos)
+			parents.top().index = 0;
+		else
+			leave_child();
+		fall_down();
+		return *this;
+	}
+	iterator operator++(int) {
+		iterator temp {*this};
+		++*this;
+		return temp;
+	}
+	iterator& operator--() {
+		if(at_end)
+			at_end = false;
+		else if(parents.top().index == npos) {
+			parents.pop();
+			built.pop_back();
+		}
+		else
+			built.pop_back();
+		climb_back();
+		return *this;
+	}
+	iterator operator--(int) {
+		iterator temp {*this};
+		--*this;
+		return temp;
+	}
+
+	bool operator==(const iterator& other) const {
+		return at_end == other.at_end && (at_end || parents.top() == other.parents.top());
+	}
+	bool operator!=(const iterator& other) const { return !operator==(other); }
+private:
+	iterator(const trie_view<T>* view, std::stack<state>&& parents, const T& built, bool at_end) :
+		view{view}, parents{std::move(parents)}, built{built}, at_end{at_end} {}
+
+	void inline leave_child() {
+		built.pop_back();
+		++parents.top().index;
+	}
+	// Moves forward from the top state to the first key at or after it.
+	void fall_down() {
+		for(;;) {
+			state& top = parents.top();
+			if(top.index == npos)
+				return;
+			if(top.index == top.node->children) {
+				if(parents.size() == 1) {
+					at_end = true;
+					return;
+				}
+				parents.pop();
+				leave_child();
+				continue;
+			}
+			built.push_back(trie_view<T>::layout::symbols(top.node)[top.index]);
+			const trie_image_node* child = view->child(top.node, top.index);
+			if(child == nullptr)
+				return;
+			parents.push({child, child->is_leaf ? npos : 0});
+		}
+	}
+	// Moves backward from the top state, whose child has already been left,
+	// to the last key before it.
+	void climb_back() {
+		while(parents.top().index == 0) {
+			if(parents.top().node->is_leaf) {
+				parents.top().index = npos;
+				return;
+			}
+			parents.pop();
+			built.pop_back();
+		}
+		--parents.top().index;
+		for(;;) {
+			const state& top = parents.top();
+			built.push_back(trie_view<T>::layout::symbols(top.node)[top.index]);
+			const trie_image_node* child = view->child(top.node, top.index);
+			if(child == nullptr)
+				return;
+			parents.push({child, child->children - 1});
+		}
+	}
+};
+
+template<typename T>
+constexpr uint32_t trie_view<T>::iterator::npos;
+
+#endif